@@ -0,0 +1,75 @@
+#include "../tomasulo.h"
+
+// Runs one trace under several configurations with runBatch and checks each
+// result against runSimulation on its own.
+//
+//   batch <trace> <config-file> <threads> <job>...
+//
+// A job is a comma-separated list of key=value settings applied on top of the
+// config file, or "-" for the file as is.
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        cerr << "usage: " << argv[0] << " <trace> <config-file> <threads> <job>..." << endl;
+        return -1;
+    }
+    SimulatorConfig base;
+    string error;
+    int threads;
+    if (!loadConfigFile(argv[2], base, error) || !parseInt(argv[3], threads))
+    {
+        cerr << (error != "" ? error : "threads: expected an integer") << endl;
+        return -1;
+    }
+    Trace *trace = loadTrace(argv[1], base, error);
+    if (trace == NULL)
+    {
+        cerr << error << endl;
+        return -1;
+    }
+
+    vector<SimulatorConfig> configs;
+    for (int i = 4; i < argc; i++)
+    {
+        SimulatorConfig config = base;
+        stringstream settings(argv[i]);
+        string setting;
+        while (getline(settings, setting, ','))
+        {
+            size_t equals = setting.find('=');
+            if (setting == "-")
+                continue;
+            if (equals == string::npos || !config.set(setting.substr(0, equals), setting.substr(equals + 1), error))
+            {
+                cerr << argv[i] << ": " << (equals == string::npos ? "expected key=value" : error) << endl;
+                return -1;
+            }
+        }
+        configs.push_back(config);
+    }
+
+    vector<SimulationResult> results;
+    if (!runBatch(trace, configs, threads, results, error))
+    {
+        cerr << error << endl;
+        return -1;
+    }
+    int mismatches = 0;
+    for (int i = 0; i < (int)configs.size(); i++)
+    {
+        SimulationResult single;
+        if (!runSimulation(trace, configs[i], single, error))
+        {
+            cerr << "job " << i << ": " << error << endl;
+            return -1;
+        }
+        bool same = single.cycles == results[i].cycles && single.finishedInstructions == results[i].finishedInstructions;
+        cout << "job " << i << " (" << argv[i + 4] << "): " << results[i].cycles << " cycles, "
+             << results[i].finishedInstructions << " instructions\t" << (same ? "matches" : "differs from") << " runSimulation" << endl;
+        if (!same)
+            mismatches++;
+    }
+    delete trace;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#!/bin/bash
+# Regression tests: runs every case in cases.txt and compares its output with
+# expected/<name>.out.
+#
+#   tests/run.sh            build the simulator and check every case
+#   tests/run.sh --update   rewrite the expected output instead
+#
+# A case line is "<name> <simulator arguments...>", relative to this directory;
+# "<name> batch <arguments...>" runs the runBatch driver in batch.cpp instead,
+# and "<name> profile <arguments...>" a simulator built with -DTOMASULO_PROFILE.
+# Output is stdout and stderr together, plus the exit status when it is not 0
+# (124 for a case stopped after a minute).
+# Host timings, and the times in the host profile, are masked, as they differ
+# from run to run.
+#
+# Every simulator case also runs with specialize=false, and the generic core
+# must print the same output as the specialized one. The analytic model's error
+# on each case that reports it is listed at the end.
+
+cd "$(dirname "$0")" || exit 1
+update=false
+if [ "$1" = "--update" ]; then
+    update=true
+fi
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++11 -O2"}
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+sim=$build/tomasulo
+batch=$build/batch
+profiled=$build/tomasulo-profile
+if ! $CXX $CXXFLAGS -pthread -o "$sim" ../tomasul.cpp ../tomasulo.cpp ||
+    ! $CXX $CXXFLAGS -pthread -o "$batch" batch.cpp ../tomasulo.cpp ||
+    ! $CXX $CXXFLAGS -pthread -DTOMASULO_PROFILE -o "$profiled" ../tomasul.cpp ../tomasulo.cpp; then
+    echo "build failed"
+    exit 1
+fi
+
+# Runs the simulator and prints what a golden file holds.
+run_case() {
+    local program=$sim output status
+    if [ "$1" = "batch" ]; then
+        program=$batch
+        shift
+    elif [ "$1" = "profile" ]; then
+        program=$profiled
+        shift
+    fi
+    output=$(timeout 60 "$program" "$@" 2>&1)
+    status=$?
+    echo "$output" | sed -E 's/[0-9.]+ ?(ms|us|ns)\b/<time>\1/g; s/speedup: [0-9.]+x/speedup: <n>x/' |
+        sed -E 's/^(  [a-zA-Z]+\t)[0-9.e+-]+(\t[0-9]+ calls)?$/\1<time>\2/'
+    if [ $status -ne 0 ]; then
+        echo "exit status $status"
+    fi
+}
+
+failed=0
+total=0
+analytic=""
+while read -r name args; do
+    if [ -z "$name" ] || [ "${name:0:1}" = "#" ]; then
+        continue
+    fi
+    total=$((total + 1))
+    # shellcheck disable=SC2086 # arguments are split on purpose
+    actual=$(run_case $args)
+    if $update; then
+        echo "$actual" > "expected/$name.out"
+        continue
+    fi
+    error=$(echo "$actual" | sed -n -E 's/^Analytic IPC: .*error: ([-0-9.e]+)%.*/\1/p')
+    if [ -n "$error" ]; then
+        analytic+="$name $error"$'\n'
+    fi
+    if ! diff -u "expected/$name.out" <(echo "$actual") > "$build/diff"; then
+        echo "FAIL $name"
+        head -40 "$build/diff"
+        failed=$((failed + 1))
+        continue
+    fi
+    # batch jobs and the legacy positional form take no key=value settings
+    set -- $args
+    if [ "$1" = "batch" ] || [ "$1" = "profile" ] || [[ "$2" =~ ^-?[0-9]+$ ]]; then
+        continue
+    fi
+    # shellcheck disable=SC2086
+    if ! diff -u "expected/$name.out" <(run_case $args specialize=false) > "$build/diff"; then
+        echo "FAIL $name (specialize=false)"
+        head -40 "$build/diff"
+        failed=$((failed + 1))
+    fi
+done < cases.txt
+
+if $update; then
+    echo "updated $total cases"
+    exit 0
+fi
+if [ -n "$analytic" ]; then
+    echo "Analytic model error against the detailed core:"
+    echo -n "$analytic" | awk '{ printf "  %-40s %8.1f%%\n", $1, $2; sum += $2 < 0 ? -$2 : $2; if ($2 > max || -$2 > max) max = $2 < 0 ? -$2 : $2 }
+        END { printf "  mean absolute %.1f%%, largest %.1f%%\n", sum / NR, max }'
+fi
+echo "$((total - failed)) of $total cases passed"
+[ $failed -eq 0 ]
@@ -0,0 +1,1375 @@
+#include "tomasulo.h"
+
+string ReservationStationTypeString[] = {"ADD", "MULT", "MEM", "BRANCH", "VEC"};
+
+#ifdef TOMASULO_PROFILE
+HostProfile hostProfile;
+
+HostProfile::HostProfile(void)
+{
+    for (int i = 0; i < PROFILE_PHASES; i++)
+    {
+        ticks[i].store(0);
+        calls[i].store(0);
+    }
+    startTicks = now();
+    startTime = chrono::steady_clock::now();
+}
+
+void HostProfile::report(long long instructions)
+{
+    const char *names[] = {"parse", "run", "execute", "execMemory", "writeBack", "commit", "advanceStage", "speculativeClear"};
+    double elapsedNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startTime).count();
+    unsigned long long elapsedTicks = now() - startTicks;
+    double nsPerTick = elapsedTicks > 0 ? elapsedNs / elapsedTicks : 0.0;
+    double perInstruction = instructions > 0 ? nsPerTick / instructions : 0.0;
+
+    cout << "Host profile (ns per simulated instruction):" << endl;
+    for (int i = 0; i < PROFILE_PHASES; i++)
+    {
+        cout << "  " << names[i] << "\t" << ticks[i].load() * perInstruction << "\t" << calls[i].load() << " calls" << endl;
+    }
+    unsigned long long phases = 0;
+    for (int i = PROFILE_EXECUTE; i < PROFILE_PHASES; i++)
+        phases += ticks[i].load();
+    unsigned long long run = ticks[PROFILE_RUN].load();
+    cout << "  other\t" << (run > phases ? run - phases : 0) * perInstruction << endl;
+}
+#endif
+
+Instruction::Instruction(void)
+{
+
+    type = NOP;
+    dest = -1;
+    src1 = -1;
+    src2 = -1;
+    id = -1;
+    decoded = NULL;
+    issue = -1;
+    execStart = -1;
+    execEnd = -1;
+    memoryStart = -1;
+    memoryEnd = -1;
+    writeCDB = -1;
+    commit = -1;
+    stage = NOTISSUED;
+    fusedHead = false;
+}
+
+// "r6" is integer register 6, "f6" FP register 6, "v6" vector register 6.
+static int parseRegister(string token)
+{
+    int number = atoi(token.c_str() + 1);
+    if (token[0] == 'f' || token[0] == 'F')
+        return FP_REGISTER_OFFSET + number;
+    if (token[0] == 'v' || token[0] == 'V')
+        return VECTOR_REGISTER_OFFSET + number;
+    return number;
+}
+
+StaticInstruction::StaticInstruction(string newInst)
+{
+    instructionString = newInst;
+    string buf;
+    stringstream ss(newInst);
+    vector<string> tokens;
+
+    while (ss >> buf)
+    {
+        tokens.push_back(buf);
+    }
+
+    if (tokens[0] == "ADD")
+        type = ADD;
+    else if (tokens[0] == "SUB")
+        type = SUB;
+    else if (tokens[0] == "MULT")
+        type = MULT;
+    else if (tokens[0] == "DIV")
+        type = DIV;
+    else if (tokens[0] == "LW")
+        type = LW;
+    else if (tokens[0] == "SW")
+        type = SW;
+    else if (tokens[0] == "BNE")
+        type = BNE;
+    else if (tokens[0] == "VADD")
+        type = VADD;
+    else if (tokens[0] == "VMUL")
+        type = VMUL;
+    else if (tokens[0] == "VLW")
+        type = VLW;
+    else if (tokens[0] == "VSW")
+        type = VSW;
+    else
+        type = NOP;
+
+    dest = -1;
+    src1 = -1;
+    src2 = -1;
+    pc = -1;
+    value = 0;
+    address = -1;
+    taken = false;
+
+    if (tokens.size() > 1)
+    {
+        dest = parseRegister(tokens[1]);
+    }
+    if (tokens.size() > 2)
+    {
+        src1 = parseRegister(tokens[2]);
+    }
+    if (tokens.size() > 3)
+    {
+        src2 = parseRegister(tokens[3]);
+    }
+
+    // Store and BNE has 2 source operands and no destination operand
+    if (type == SW || type == VSW || type == BNE)
+    {
+        src2 = src1;
+        src1 = dest;
+        dest = -1;
+    }
+}
+
+Instruction::Instruction(const StaticInstruction *decoded, int id)
+{
+    this->id = id;
+    this->decoded = decoded;
+    type = decoded->type;
+    dest = decoded->dest;
+    src1 = decoded->src1;
+    src2 = decoded->src2;
+    issue = -1;
+    execStart = -1;
+    execEnd = -1;
+    memoryStart = -1;
+    memoryEnd = -1;
+    writeCDB = -1;
+    commit = -1;
+    stage = NOTISSUED;
+    fusedHead = false;
+}
+
+Register::Register(void)
+{
+
+    dataValue = "";
+    registerNumber = -1;
+    registerName = "";
+}
+
+void Register::clearDependencyValues(string dependentValue)
+{
+    if (dataValue == dependentValue)
+    {
+        dataValue = "";
+    }
+}
+
+void TomsuloSimulator::execute()
+{
+    PROFILE_SCOPE(PROFILE_RUN);
+    while (step())
+        ;
+}
+
+static void countRegisters(Trace *trace, StaticInstruction &instr)
+{
+    for (int operand : {instr.dest, instr.src1, instr.src2})
+    {
+        if (operand >= VECTOR_REGISTER_OFFSET)
+            trace->vectorRegistersUsed = max(trace->vectorRegistersUsed, operand - VECTOR_REGISTER_OFFSET + 1);
+        else if (operand >= FP_REGISTER_OFFSET)
+            trace->fpRegistersUsed = max(trace->fpRegistersUsed, operand - FP_REGISTER_OFFSET + 1);
+        else if (operand != -1)
+            trace->intRegistersUsed = max(trace->intRegistersUsed, operand + 1);
+    }
+}
+
+// Decodes every line of a program file, in order. False if it cannot be opened.
+static bool readLines(string fileName, vector<StaticInstruction> &program)
+{
+    PROFILE_SCOPE(PROFILE_PARSE);
+    string sLine = "";
+    ifstream infile;
+
+    infile.open(fileName.c_str(), std::ifstream::in);
+
+    if (!infile)
+    {
+        return false;
+    }
+    while (!infile.eof())
+    {
+        getline(infile, sLine);
+        if (sLine.empty())
+            break;
+        program.push_back(StaticInstruction(sLine));
+        program.back().pc = program.size() - 1;
+    }
+
+    infile.close();
+    return true;
+}
+
+// Each line is decoded once; a loop body ending in BNE is unrolled by copying
+// the already decoded instructions. NULL if the file cannot be opened.
+Trace *readFile(string fileName)
+{
+    vector<StaticInstruction> program;
+    if (!readLines(fileName, program))
+        return NULL;
+
+    Trace *trace = new Trace();
+    vector<StaticInstruction> &instructions = trace->instructions;
+    int loopStart = 0;
+    for (auto &instr : program)
+    {
+        instructions.push_back(instr);
+        countRegisters(trace, instr);
+
+        if (instr.type == BNE)
+        {
+            int loopEnd = instructions.size();
+            for (int i = 1; i < 4; i++)
+            {
+                for (int j = loopStart; j < loopEnd; j++)
+                {
+                    instructions.push_back(instructions[j]);
+                }
+            }
+            loopStart = instructions.size();
+        }
+    }
+
+    return trace;
+}
+
+// Executes the program and records the instructions it really runs. A BNE that
+// is taken jumps back to the first instruction after the previous BNE.
+Trace *runProgram(vector<StaticInstruction> &program, SimulatorConfig &config)
+{
+    Trace *trace = new Trace();
+    trace->correctPath = true;
+    FunctionalEngine engine(config);
+
+    vector<int> loopStart(program.size());
+    int start = 0;
+    for (int pc = 0; pc < (int)program.size(); pc++)
+    {
+        loopStart[pc] = start;
+        countRegisters(trace, program[pc]);
+        if (program[pc].type == BNE)
+            start = pc + 1;
+    }
+
+    int pc = 0;
+    while (pc < (int)program.size())
+    {
+        if ((int)trace->instructions.size() >= config.maxInstructions)
+        {
+            cerr << "Stopped after maxInstructions (" << config.maxInstructions << ") executed instructions" << endl;
+            break;
+        }
+        trace->instructions.push_back(program[pc]);
+        StaticInstruction &instr = trace->instructions.back();
+        engine.execute(instr);
+        pc = (instr.type == BNE && instr.taken) ? loopStart[pc] : pc + 1;
+    }
+    return trace;
+}
+
+// Builds the trace a configuration asks for: the executed program in functional
+// mode, otherwise the unrolled file annotated with the values it computes.
+Trace *loadTrace(string fileName, SimulatorConfig &config, string &error)
+{
+    Trace *trace;
+    if (config.functional)
+    {
+        vector<StaticInstruction> program;
+        if (!readLines(fileName, program))
+        {
+            error = "Failed to open file " + fileName;
+            return NULL;
+        }
+        trace = runProgram(program, config);
+    }
+    else
+    {
+        trace = readFile(fileName);
+        if (trace == NULL)
+        {
+            error = "Failed to open file " + fileName;
+            return NULL;
+        }
+        FunctionalEngine engine(config);
+        for (auto &instr : trace->instructions)
+        {
+            engine.execute(instr);
+        }
+    }
+
+    if (!config.fits(trace, error))
+    {
+        delete trace;
+        return NULL;
+    }
+    return trace;
+}
+
+FunctionalEngine::FunctionalEngine(SimulatorConfig &config)
+{
+    intRegisters = config.intRegisters;
+    fpRegisters = config.fpRegisters;
+    registers.resize(config.intRegisters + config.fpRegisters + config.vectorRegisters, 0);
+    for (auto it : config.initialRegisters)
+    {
+        reg(it.first) = it.second;
+    }
+    for (auto it : config.initialMemory)
+    {
+        memory[it.first] = it.second;
+    }
+}
+
+void FunctionalEngine::execute(StaticInstruction &instr)
+{
+    // a vector register holds one value for all its elements
+    long long a = instr.src1 == -1 ? 0 : reg(instr.src1);
+    long long b = instr.src2 == -1 ? 0 : reg(instr.src2);
+    instr.address = -1;
+    instr.taken = false;
+
+    // arithmetic wraps in two's complement, as signed overflow is undefined
+    unsigned long long ua = a, ub = b;
+    switch (instr.type)
+    {
+    case ADD:
+    case VADD:
+        instr.value = (long long)(ua + ub);
+        break;
+    case SUB:
+        instr.value = (long long)(ua - ub);
+        break;
+    case MULT:
+    case VMUL:
+        instr.value = (long long)(ua * ub);
+        break;
+    case DIV:
+        // x / -1 is a negation, which overflows for the most negative value
+        instr.value = b == 0 ? 0 : (b == -1 ? (long long)(0 - ua) : a / b);
+        break;
+    case LW:
+    case VLW:
+    {
+        instr.address = a;
+        auto found = memory.find(instr.address);
+        instr.value = found == memory.end() ? 0 : found->second;
+        break;
+    }
+    case SW:
+    case VSW:
+        // SW value address: src1 holds the value, src2 the address
+        instr.address = b;
+        instr.value = a;
+        memory[instr.address] = a;
+        break;
+    case BNE:
+        instr.taken = a != b;
+        break;
+    default:
+        break;
+    }
+
+    if (instr.dest != -1)
+        reg(instr.dest) = instr.value;
+}
+
+SimulationResult TomsuloSimulator::getResult()
+{
+    SimulationResult result;
+    result.cycles = getCycleCount();
+    result.finishedInstructions = 0;
+    result.stats = getStats();
+    for (auto &it : instructions)
+    {
+        if (it.getStage() == FINISHED)
+        {
+            result.finishedInstructions++;
+            // squashed pairs issue again, so only count the ones that finished
+            if (it.fusedHead)
+                result.stats.fusedPairs++;
+        }
+    }
+    result.ipc = result.cycles > 0 ? (double)result.finishedInstructions / result.cycles : 0.0;
+    return result;
+}
+
+SimulatorConfig::SimulatorConfig(void)
+{
+    addUnits = 3;
+    multUnits = 2;
+    branchUnits = 2;
+    memoryUnits = 5;
+    memoryCycle = 1;
+    adderCycle = 1;
+    multCycle = 2;
+    branchCycle = 1;
+    issueCount = 2;
+    commitCount = 2;
+    isBranchTaken = false;
+    isSpeculative = false;
+    quantumCycles = 100;
+    sharedMemoryPorts = 2;
+    specialize = true;
+    intRegisters = 32;
+    fpRegisters = 32;
+    vectorRegisters = 8;
+    functional = false;
+    maxInstructions = 1000000;
+    memoryDependence = MEMDEP_NONE;
+    storeSetSize = 1024;
+    valuePredictor = VALUEPRED_NONE;
+    valuePredictorSize = 1024;
+    valuePredictorThreshold = 2;
+    fusion = FUSE_NONE;
+    clusters = 1;
+    steering = STEER_DEPENDENCE;
+    clusterBypassDelay = 1;
+    energyFile = "";
+    prefetcher = PREFETCH_NONE;
+    prefetchDegree = 1;
+    prefetchDistance = 1;
+    prefetchTableSize = 256;
+    prefetchBufferSize = 32;
+    lineSize = 16;
+    prefetchHitCycle = 1;
+    intervalCycles = 0;
+    intervalFile = "";
+    progress = false;
+    dataflowLimit = false;
+    criticalPathTop = 5;
+    analyticModel = false;
+    vectorUnits = 2;
+    vectorLength = 8;
+    vectorLanes = 4;
+    vectorMemoryWidth = 4;
+    schedulerDepth = 0;
+    loadReplay = REPLAY_NONE;
+}
+
+static string trim(string value)
+{
+    size_t start = value.find_first_not_of(" \t\r\n");
+    if (start == string::npos)
+        return "";
+    size_t end = value.find_last_not_of(" \t\r\n");
+    return value.substr(start, end - start + 1);
+}
+
+static bool parseLong(string value, long long &out)
+{
+    if (value.empty())
+        return false;
+    char *end;
+    out = strtoll(value.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+bool parseInt(string value, int &out)
+{
+    if (value.empty())
+        return false;
+    char *end;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (*end != '\0')
+        return false;
+    out = (int)parsed;
+    return true;
+}
+
+bool SimulatorConfig::set(string key, string value, string &error)
+{
+    map<string, int *> ints = {
+        {"addUnits", &addUnits},
+        {"multUnits", &multUnits},
+        {"branchUnits", &branchUnits},
+        {"memoryUnits", &memoryUnits},
+        {"memoryCycle", &memoryCycle},
+        {"adderCycle", &adderCycle},
+        {"multCycle", &multCycle},
+        {"branchCycle", &branchCycle},
+        {"issueCount", &issueCount},
+        {"commitCount", &commitCount},
+        {"quantumCycles", &quantumCycles},
+        {"sharedMemoryPorts", &sharedMemoryPorts},
+        {"intRegisters", &intRegisters},
+        {"fpRegisters", &fpRegisters},
+        {"vectorRegisters", &vectorRegisters},
+        {"maxInstructions", &maxInstructions},
+        {"storeSetSize", &storeSetSize},
+        {"valuePredictorSize", &valuePredictorSize},
+        {"valuePredictorThreshold", &valuePredictorThreshold},
+        {"clusters", &clusters},
+        {"clusterBypassDelay", &clusterBypassDelay},
+        {"prefetchDegree", &prefetchDegree},
+        {"prefetchDistance", &prefetchDistance},
+        {"prefetchTableSize", &prefetchTableSize},
+        {"prefetchBufferSize", &prefetchBufferSize},
+        {"lineSize", &lineSize},
+        {"prefetchHitCycle", &prefetchHitCycle},
+        {"intervalCycles", &intervalCycles},
+        {"criticalPathTop", &criticalPathTop},
+        {"vectorUnits", &vectorUnits},
+        {"vectorLength", &vectorLength},
+        {"vectorLanes", &vectorLanes},
+        {"vectorMemoryWidth", &vectorMemoryWidth},
+        {"schedulerDepth", &schedulerDepth}};
+    map<string, bool *> bools = {
+        {"isBranchTaken", &isBranchTaken},
+        {"isSpeculative", &isSpeculative},
+        {"specialize", &specialize},
+        {"functional", &functional},
+        {"progress", &progress},
+        {"dataflowLimit", &dataflowLimit},
+        {"analyticModel", &analyticModel}};
+
+    if (key == "memoryDependence")
+    {
+        map<string, MemoryDependenceMode> modes = {
+            {"none", MEMDEP_NONE},
+            {"conservative", MEMDEP_CONSERVATIVE},
+            {"storeset", MEMDEP_STORESET}};
+        if (!modes.count(value))
+        {
+            error = key + ": expected none, conservative or storeset, got '" + value + "'";
+            return false;
+        }
+        memoryDependence = modes[value];
+        return true;
+    }
+
+    if (key == "valuePredictor")
+    {
+        map<string, ValuePredictorMode> modes = {
+            {"none", VALUEPRED_NONE},
+            {"last", VALUEPRED_LAST},
+            {"stride", VALUEPRED_STRIDE}};
+        if (!modes.count(value))
+        {
+            error = key + ": expected none, last or stride, got '" + value + "'";
+            return false;
+        }
+        valuePredictor = modes[value];
+        return true;
+    }
+
+    if (key == "energyFile")
+    {
+        energyFile = value;
+        return true;
+    }
+    if (key == "intervalFile")
+    {
+        intervalFile = value;
+        return true;
+    }
+
+    if (key == "prefetcher")
+    {
+        map<string, PrefetcherMode> modes = {
+            {"none", PREFETCH_NONE},
+            {"nextline", PREFETCH_NEXTLINE},
+            {"stride", PREFETCH_STRIDE}};
+        if (!modes.count(value))
+        {
+            error = key + ": expected none, nextline or stride, got '" + value + "'";
+            return false;
+        }
+        prefetcher = modes[value];
+        return true;
+    }
+
+    if (key == "loadReplay")
+    {
+        map<string, LoadReplayMode> modes = {
+            {"none", REPLAY_NONE},
+            {"selective", REPLAY_SELECTIVE},
+            {"flush", REPLAY_FLUSH}};
+        if (!modes.count(value))
+        {
+            error = key + ": expected none, selective or flush, got '" + value + "'";
+            return false;
+        }
+        loadReplay = modes[value];
+        return true;
+    }
+
+    if (key == "steering")
+    {
+        map<string, SteeringPolicy> policies = {
+            {"roundrobin", STEER_ROUNDROBIN},
+            {"loadbalance", STEER_LOADBALANCE},
+            {"dependence", STEER_DEPENDENCE}};
+        if (!policies.count(value))
+        {
+            error = key + ": expected roundrobin, loadbalance or dependence, got '" + value + "'";
+            return false;
+        }
+        steering = policies[value];
+        return true;
+    }
+
+    // rules joined with '+', e.g. "add-bne+lw-add"
+    if (key == "fusion")
+    {
+        map<string, FusionRule> rules = {
+            {"none", FUSE_NONE},
+            {"add-bne", FUSE_ADD_BNE},
+            {"lw-add", FUSE_LW_ADD}};
+        int mask = FUSE_NONE;
+        stringstream ss(value);
+        string rule;
+        while (getline(ss, rule, '+'))
+        {
+            rule = trim(rule);
+            if (!rules.count(rule))
+            {
+                error = key + ": expected none, add-bne or lw-add, got '" + rule + "'";
+                return false;
+            }
+            mask |= rules[rule];
+        }
+        fusion = mask;
+        return true;
+    }
+
+    // initial architectural state for the functional engine
+    if (key.compare(0, 5, "init.") == 0 || key.compare(0, 4, "mem.") == 0)
+    {
+        long long number;
+        if (!parseLong(value, number))
+        {
+            error = key + ": expected an integer, got '" + value + "'";
+            return false;
+        }
+        if (key[0] == 'm')
+        {
+            long long address;
+            if (!parseLong(key.substr(4), address))
+            {
+                error = "bad memory address in '" + key + "'";
+                return false;
+            }
+            initialMemory[address] = number;
+        }
+        else
+        {
+            string reg = key.substr(5);
+            int index;
+            if (reg.size() < 2 || (reg[0] != 'r' && reg[0] != 'f') || !parseInt(reg.substr(1), index) || index < 0)
+            {
+                error = "bad register in '" + key + "'";
+                return false;
+            }
+            initialRegisters[parseRegister(reg)] = number;
+        }
+        return true;
+    }
+
+    if (ints.count(key))
+    {
+        if (!parseInt(value, *ints[key]))
+        {
+            error = key + ": expected an integer, got '" + value + "'";
+            return false;
+        }
+        return true;
+    }
+    if (bools.count(key))
+    {
+        if (value == "true" || value == "1")
+            *bools[key] = true;
+        else if (value == "false" || value == "0")
+            *bools[key] = false;
+        else
+        {
+            error = key + ": expected true or false, got '" + value + "'";
+            return false;
+        }
+        return true;
+    }
+
+    error = "unknown key '" + key + "'";
+    return false;
+}
+
+bool SimulatorConfig::validate(string &error)
+{
+    map<string, int> positive = {
+        {"addUnits", addUnits},
+        {"multUnits", multUnits},
+        {"branchUnits", branchUnits},
+        {"memoryUnits", memoryUnits},
+        {"memoryCycle", memoryCycle},
+        {"adderCycle", adderCycle},
+        {"multCycle", multCycle},
+        {"branchCycle", branchCycle},
+        {"issueCount", issueCount},
+        {"commitCount", commitCount},
+        {"quantumCycles", quantumCycles},
+        {"sharedMemoryPorts", sharedMemoryPorts},
+        {"intRegisters", intRegisters},
+        {"maxInstructions", maxInstructions},
+        {"storeSetSize", storeSetSize},
+        {"valuePredictorSize", valuePredictorSize},
+        {"clusters", clusters},
+        {"prefetchDegree", prefetchDegree},
+        {"prefetchDistance", prefetchDistance},
+        {"prefetchTableSize", prefetchTableSize},
+        {"prefetchBufferSize", prefetchBufferSize},
+        {"lineSize", lineSize},
+        {"prefetchHitCycle", prefetchHitCycle},
+        {"vectorUnits", vectorUnits},
+        {"vectorLength", vectorLength},
+        {"vectorLanes", vectorLanes},
+        {"vectorMemoryWidth", vectorMemoryWidth}};
+
+    for (auto it : positive)
+    {
+        if (it.second < 1)
+        {
+            error = it.first + " must be at least 1";
+            return false;
+        }
+    }
+    if (intervalCycles < 0)
+    {
+        error = "intervalCycles must not be negative";
+        return false;
+    }
+    if ((intervalFile != "" || progress) && intervalCycles == 0)
+    {
+        error = "intervalFile and progress need intervalCycles";
+        return false;
+    }
+    if (schedulerDepth < 0)
+    {
+        error = "schedulerDepth must not be negative";
+        return false;
+    }
+    if (clusterBypassDelay < 0)
+    {
+        error = "clusterBypassDelay must not be negative";
+        return false;
+    }
+    if (valuePredictorThreshold < 0 || valuePredictorThreshold > 3)
+    {
+        error = "valuePredictorThreshold must be between 0 and 3";
+        return false;
+    }
+    if (fpRegisters < 0)
+    {
+        error = "fpRegisters must not be negative";
+        return false;
+    }
+    if (vectorRegisters < 0)
+    {
+        error = "vectorRegisters must not be negative";
+        return false;
+    }
+    return true;
+}
+
+bool SimulatorConfig::fits(const Trace *trace, string &error)
+{
+    if (trace->intRegistersUsed > intRegisters)
+    {
+        error = "trace uses r" + to_string(trace->intRegistersUsed - 1) + " but intRegisters is " + to_string(intRegisters);
+        return false;
+    }
+    if (trace->fpRegistersUsed > fpRegisters)
+    {
+        error = "trace uses f" + to_string(trace->fpRegistersUsed - 1) + " but fpRegisters is " + to_string(fpRegisters);
+        return false;
+    }
+    if (trace->vectorRegistersUsed > vectorRegisters)
+    {
+        error = "trace uses v" + to_string(trace->vectorRegistersUsed - 1) + " but vectorRegisters is " + to_string(vectorRegisters);
+        return false;
+    }
+    return true;
+}
+
+// Flat JSON object of scalar values: { "addUnits": 3, "isSpeculative": true }
+static bool loadJsonConfig(string text, SimulatorConfig &config, string &error)
+{
+    size_t pos = text.find('{') + 1;
+    while (true)
+    {
+        pos = text.find_first_not_of(" \t\r\n,", pos);
+        if (pos == string::npos)
+        {
+            error = "missing closing '}'";
+            return false;
+        }
+        if (text[pos] == '}')
+            return true;
+        if (text[pos] != '"')
+        {
+            error = "expected a quoted key at offset " + to_string(pos);
+            return false;
+        }
+        size_t keyEnd = text.find('"', pos + 1);
+        size_t colon = keyEnd == string::npos ? string::npos : text.find(':', keyEnd);
+        if (colon == string::npos)
+        {
+            error = "expected ':' after key at offset " + to_string(pos);
+            return false;
+        }
+        string key = text.substr(pos + 1, keyEnd - pos - 1);
+        size_t valueEnd = text.find_first_of(",}", colon + 1);
+        if (valueEnd == string::npos)
+        {
+            error = "missing closing '}'";
+            return false;
+        }
+        string value = trim(text.substr(colon + 1, valueEnd - colon - 1));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+            value = value.substr(1, value.size() - 2);
+        if (!config.set(key, value, error))
+            return false;
+        pos = valueEnd;
+    }
+}
+
+// key=value per line; '#' starts a comment.
+static bool loadKeyValueConfig(string text, SimulatorConfig &config, string &error)
+{
+    stringstream ss(text);
+    string line;
+    int lineNumber = 0;
+    while (getline(ss, line))
+    {
+        lineNumber++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        size_t equals = line.find('=');
+        if (equals == string::npos)
+        {
+            error = "line " + to_string(lineNumber) + ": expected key=value";
+            return false;
+        }
+        if (!config.set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)), error))
+        {
+            error = "line " + to_string(lineNumber) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadConfigFile(string fileName, SimulatorConfig &config, string &error)
+{
+    ifstream infile(fileName.c_str(), std::ifstream::in);
+    if (!infile)
+    {
+        error = "Failed to open file " + fileName;
+        return false;
+    }
+    stringstream contents;
+    contents << infile.rdbuf();
+    string text = contents.str();
+
+    bool loaded;
+    if (trim(text).compare(0, 1, "{") == 0)
+        loaded = loadJsonConfig(text, config, error);
+    else
+        loaded = loadKeyValueConfig(text, config, error);
+
+    if (!loaded)
+    {
+        error = fileName + ": " + error;
+        return false;
+    }
+    return config.validate(error);
+}
+
+EnergyModel::EnergyModel(void)
+{
+    costs = {
+        {"issue", 1.0},   // rename and station write, per instruction
+        {"add", 2.0},
+        {"mult", 8.0},
+        {"branch", 1.5},
+        {"address", 1.0}, // load/store address generation
+        {"memory", 10.0}, // data memory access
+        {"cdb", 1.5},     // result broadcast
+        {"commit", 1.0},  // ROB retire
+        {"squash", 0.5},  // per instruction thrown away
+        {"static", 5.0}}; // leakage and clock, per cycle
+}
+
+bool EnergyModel::load(string fileName, string &error)
+{
+    ifstream infile(fileName.c_str(), std::ifstream::in);
+    if (!infile)
+    {
+        error = "Failed to open file " + fileName;
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(infile, line))
+    {
+        lineNumber++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        size_t equals = line.find('=');
+        string key = trim(line.substr(0, equals));
+        string value = equals == string::npos ? "" : trim(line.substr(equals + 1));
+        char *end;
+        double cost = strtod(value.c_str(), &end);
+        if (equals == string::npos || !costs.count(key) || value.empty() || *end != '\0' || cost < 0)
+        {
+            error = fileName + ": line " + to_string(lineNumber) + ": expected <event> = <non-negative cost>";
+            return false;
+        }
+        costs[key] = cost;
+    }
+    return true;
+}
+
+EnergyReport estimateEnergy(SimulationResult &result, EnergyModel &model)
+{
+    SimulationStats &stats = result.stats;
+    // unit name, energy
+    vector<pair<string, double>> units = {
+        {"frontend", model.costs["issue"] * stats.issued + model.costs["squash"] * stats.squashed},
+        {"adder", model.costs["add"] * stats.adderOps},
+        {"multiplier", model.costs["mult"] * stats.multOps},
+        {"vector", model.costs["add"] * stats.vectorAddOps + model.costs["mult"] * stats.vectorMultOps},
+        {"branch", model.costs["branch"] * stats.branchOps},
+        {"memory", model.costs["address"] * stats.addressOps + model.costs["memory"] * stats.memoryAccesses},
+        {"cdb", model.costs["cdb"] * stats.cdbWrites},
+        {"rob", model.costs["commit"] * result.finishedInstructions},
+        {"static", model.costs["static"] * result.cycles}};
+
+    EnergyReport report;
+    report.total = 0;
+    for (auto &unit : units)
+        report.total += unit.second;
+    int cycles = max(result.cycles, 1);
+    report.perInstruction = result.finishedInstructions ? report.total / result.finishedInstructions : 0.0;
+    report.power = report.total / cycles;
+    report.perfPerWatt = report.power > 0 ? result.ipc / report.power : 0.0;
+    for (auto &unit : units)
+        report.unitPower.push_back(make_pair(unit.first, unit.second / cycles));
+    return report;
+}
+
+template <int Speculative>
+static TomsuloSimulator *createWithWidth(const Trace *trace, SimulatorConfig &config)
+{
+    if (config.issueCount == config.commitCount)
+    {
+        switch (config.issueCount)
+        {
+        case 1:
+            return new TomsuloSimulatorCore<Speculative, 1>(trace, config);
+        case 2:
+            return new TomsuloSimulatorCore<Speculative, 2>(trace, config);
+        case 4:
+            return new TomsuloSimulatorCore<Speculative, 4>(trace, config);
+        }
+    }
+    return new TomsuloSimulatorCore<Speculative, RUNTIME_VARIANT>(trace, config);
+}
+
+// Picks the core specialized for the configuration, or the generic one.
+TomsuloSimulator *createSimulator(const Trace *trace, SimulatorConfig &config)
+{
+    if (!config.specialize)
+        return new TomsuloSimulatorCore<RUNTIME_VARIANT, RUNTIME_VARIANT>(trace, config);
+    if (config.isSpeculative)
+        return createWithWidth<1>(trace, config);
+    return createWithWidth<0>(trace, config);
+}
+
+// False with error set if the configuration is invalid or too small for the trace.
+bool runSimulation(const Trace *trace, SimulatorConfig &config, SimulationResult &result, string &error)
+{
+    if (!config.validate(error) || !config.fits(trace, error))
+        return false;
+    TomsuloSimulator *simulator = createSimulator(trace, config);
+    simulator->execute();
+    result = simulator->getResult();
+    delete simulator;
+    return true;
+}
+
+// One pass in trace order: an instruction's exec start is the cycle after its
+// last producer's CDB write (cycle 2 if it has none, as issue takes cycle 1).
+DataflowLimit analyzeDataflow(const Trace *trace, SimulatorConfig &config)
+{
+    int count = trace->instructions.size();
+    vector<int> done(count);        // CDB write (or completion, for SW/BNE)
+    vector<int> started(count);
+    vector<int> predecessor(count); // producer that set the start, -1 if none
+    vector<int> lastWriter(trace->intRegistersUsed + trace->fpRegistersUsed + trace->vectorRegistersUsed, -1);
+    unordered_map<long long, int> lastStore;
+    // the core only orders loads after stores when a memory dependence mode is on
+    bool followMemory = config.memoryDependence != MEMDEP_NONE;
+    auto registerIndex = [trace](int operand) {
+        return registerSlot(operand, trace->intRegistersUsed, trace->fpRegistersUsed);
+    };
+
+    int last = -1;
+    for (int i = 0; i < count; i++)
+    {
+        const StaticInstruction &instr = trace->instructions[i];
+        int start = 2;
+        predecessor[i] = -1;
+        int producers[] = {instr.src1 != -1 ? lastWriter[registerIndex(instr.src1)] : -1,
+                           instr.src2 != -1 ? lastWriter[registerIndex(instr.src2)] : -1};
+        for (int producer : producers)
+        {
+            if (producer != -1 && done[producer] + 1 > start)
+            {
+                start = done[producer] + 1;
+                predecessor[i] = producer;
+            }
+        }
+        // the load's access follows the store's; its address stage may overlap it
+        if (followMemory && isLoad(instr.type) && instr.address != -1 && lastStore.count(instr.address))
+        {
+            int store = lastStore[instr.address];
+            if (started[store] > start)
+            {
+                start = started[store];
+                predecessor[i] = store;
+            }
+        }
+        started[i] = start;
+
+        int latency;
+        int vectorBeats = (config.vectorLength + config.vectorLanes - 1) / config.vectorLanes;
+        int memoryBeats = (config.vectorLength + config.vectorMemoryWidth - 1) / config.vectorMemoryWidth;
+        if (instr.type == LW)
+            latency = 1 + config.memoryCycle; // address, then access
+        else if (instr.type == SW)
+            latency = config.memoryCycle;
+        else if (instr.type == VLW)
+            latency = 1 + config.memoryCycle * memoryBeats;
+        else if (instr.type == VSW)
+            latency = config.memoryCycle * memoryBeats;
+        else if (instr.type == VADD)
+            latency = config.adderCycle * vectorBeats;
+        else if (instr.type == VMUL)
+            latency = config.multCycle * vectorBeats;
+        else if (instr.type == MULT || instr.type == DIV)
+            latency = config.multCycle;
+        else if (instr.type == BNE)
+            latency = config.branchCycle;
+        else
+            latency = config.adderCycle;
+        // results need a cycle on the CDB
+        done[i] = start + latency - 1 + (instr.dest != -1 ? 1 : 0);
+
+        if (instr.dest != -1)
+            lastWriter[registerIndex(instr.dest)] = i;
+        if (isStore(instr.type) && instr.address != -1)
+            lastStore[instr.address] = i;
+        if (last == -1 || done[i] > done[last])
+            last = i;
+    }
+
+    DataflowLimit limit;
+    // plus the commit cycle
+    limit.cycles = last == -1 ? 0 : done[last] + 1;
+    limit.ipc = limit.cycles > 0 ? (double)count / limit.cycles : 0.0;
+    limit.criticalPathLength = 0;
+    map<string, int> onPath;
+    for (int i = last; i != -1; i = predecessor[i])
+    {
+        limit.criticalPathLength++;
+        const StaticInstruction &instr = trace->instructions[i];
+        onPath[instr.pc != -1 ? to_string(instr.pc) + ": " + instr.instructionString : instr.instructionString]++;
+    }
+    limit.criticalInstructions.assign(onPath.begin(), onPath.end());
+    sort(limit.criticalInstructions.begin(), limit.criticalInstructions.end(), [](const pair<string, int> &a, const pair<string, int> &b) { return a.second > b.second; });
+    if ((int)limit.criticalInstructions.size() > config.criticalPathTop)
+        limit.criticalInstructions.resize(config.criticalPathTop);
+    return limit;
+}
+
+// Largest window the profile measures, as a power of two.
+static const int PROFILE_WINDOW_LEVELS = 11;
+
+// Latency class of an instruction on a dependence chain (TraceProfile::windowChain).
+// Vector ops share their scalar counterpart's class.
+static int chainClass(InstructionType type)
+{
+    switch (type)
+    {
+    case MULT:
+    case DIV:
+    case VMUL:
+        return 1;
+    case LW:
+    case VLW:
+        return 2;
+    case SW:
+    case VSW:
+        return 3;
+    case BNE:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// A dependence chain ending at some register: its length and what it is made of.
+struct ChainLink
+{
+    int length;
+    int classes[CHAIN_CLASSES];
+};
+
+// One pass; chains for every window size are tracked side by side, with a
+// per-register window stamp instead of clearing them at each boundary.
+TraceProfile profileTrace(const Trace *trace)
+{
+    TraceProfile profile;
+    profile.instructions = trace->instructions.size();
+    fill(profile.typeCounts, profile.typeCounts + VSW + 1, 0);
+    profile.notTakenBranches = 0;
+    profile.correctPath = trace->correctPath;
+
+    int registers = trace->intRegistersUsed + trace->fpRegistersUsed + trace->vectorRegistersUsed;
+    ChainLink empty = {0, {0}};
+    vector<vector<ChainLink>> chains(PROFILE_WINDOW_LEVELS, vector<ChainLink>(registers, empty));
+    vector<vector<long long>> stamp(PROFILE_WINDOW_LEVELS, vector<long long>(registers, -1));
+    vector<ChainLink> longest(PROFILE_WINDOW_LEVELS, empty); // in the current window
+    vector<vector<double>> sums(PROFILE_WINDOW_LEVELS, vector<double>(CHAIN_CLASSES, 0));
+    auto registerIndex = [trace](int operand) {
+        return registerSlot(operand, trace->intRegistersUsed, trace->fpRegistersUsed);
+    };
+    auto addChain = [](vector<double> &sum, ChainLink &chain) {
+        for (int c = 0; c < CHAIN_CLASSES; c++)
+            sum[c] += chain.classes[c];
+    };
+
+    for (long long i = 0; i < profile.instructions; i++)
+    {
+        const StaticInstruction &instr = trace->instructions[i];
+        profile.typeCounts[instr.type]++;
+        if (instr.type == BNE && !instr.taken)
+            profile.notTakenBranches++;
+
+        for (int k = 0; k < PROFILE_WINDOW_LEVELS; k++)
+        {
+            long long window = i >> k;
+            if ((i & ((1LL << k) - 1)) == 0 && i > 0)
+            {
+                addChain(sums[k], longest[k]);
+                longest[k] = empty;
+            }
+            ChainLink chain = empty;
+            for (int source : {instr.src1, instr.src2})
+            {
+                if (source != -1 && stamp[k][registerIndex(source)] == window && chains[k][registerIndex(source)].length > chain.length)
+                    chain = chains[k][registerIndex(source)];
+            }
+            chain.length++;
+            chain.classes[chainClass(instr.type)]++;
+            if (instr.dest != -1)
+            {
+                chains[k][registerIndex(instr.dest)] = chain;
+                stamp[k][registerIndex(instr.dest)] = window;
+            }
+            if (chain.length > longest[k].length)
+                longest[k] = chain;
+        }
+    }
+
+    for (int k = 0; k < PROFILE_WINDOW_LEVELS; k++)
+    {
+        addChain(sums[k], longest[k]);
+        long long windows = max((profile.instructions + (1LL << k) - 1) >> k, 1LL);
+        vector<double> average(CHAIN_CLASSES);
+        for (int c = 0; c < CHAIN_CLASSES; c++)
+            average[c] = sums[k][c] / windows;
+        profile.windowChain.push_back(average);
+    }
+    return profile;
+}
+
+// First-order interval model: steady-state IPC is bounded by issue/commit
+// width, by each unit's throughput (units are not pipelined), and by how fast
+// a window of in-flight instructions drains along its dependence chains. Each
+// branch that stops issue then adds its resolution time. Fusion, prefetching,
+// clustering delays and value prediction are not modelled, and a vector op
+// counts as its scalar counterpart on a dependence chain.
+double estimateIpc(const TraceProfile &profile, SimulatorConfig &config)
+{
+    if (profile.instructions == 0)
+        return 0.0;
+    double n = profile.instructions;
+    const long long *count = profile.typeCounts;
+    double adds = count[ADD] + count[SUB], mults = count[MULT] + count[DIV];
+    double loads = count[LW], stores = count[SW], branches = count[BNE];
+    double vadds = count[VADD], vmuls = count[VMUL], vloads = count[VLW], vstores = count[VSW];
+    // passes through the vector unit, and memory-port beats, per vector op
+    double vectorBeats = (config.vectorLength + config.vectorLanes - 1) / config.vectorLanes;
+    double memoryBeats = (config.vectorLength + config.vectorMemoryWidth - 1) / config.vectorMemoryWidth;
+    double vectorBusy = vadds * config.adderCycle * vectorBeats + vmuls * config.multCycle * vectorBeats;
+
+    double ipc = min(config.issueCount, config.commitCount);
+    // unit throughput, one unit of each class per cluster
+    if (adds > 0)
+        ipc = min(ipc, config.clusters * n / (adds * config.adderCycle));
+    if (mults > 0)
+        ipc = min(ipc, config.clusters * n / (mults * config.multCycle));
+    if (branches > 0)
+        ipc = min(ipc, config.clusters * n / (branches * config.branchCycle));
+    if (vectorBusy > 0)
+        ipc = min(ipc, config.clusters * n / vectorBusy);
+    // only loads hold the memory port for their whole access; a vector store
+    // holds it for all but its last beat
+    double portBeats = loads + vloads * memoryBeats + vstores * (memoryBeats - 1);
+    if (portBeats > 0)
+        ipc = min(ipc, n / (portBeats * config.memoryCycle));
+
+    // average producer-to-consumer latency, CDB cycle included
+    double latency = (adds * (config.adderCycle + 1) + mults * (config.multCycle + 1) + loads * (config.memoryCycle + 2) +
+                      stores * config.memoryCycle + branches * config.branchCycle + vectorBusy + vadds + vmuls +
+                      vloads * (config.memoryCycle * memoryBeats + 2) + vstores * config.memoryCycle * memoryBeats) /
+                     n;
+
+    // vector loads and stores share the scalar memory stations
+    double memoryOps = loads + stores + vloads + vstores;
+    double memoryHold = (loads + stores) * (config.memoryCycle + 3.0) + (vloads + vstores) * (config.memoryCycle * memoryBeats + 3.0);
+    // Issue is in order, so a full class of stations stops it: the window holds
+    // as many instructions as the scarcest class allows. A station is held from
+    // issue through its CDB write.
+    double classes[][3] = {
+        {adds, (double)config.addUnits, config.adderCycle + 2.0},
+        {mults, (double)config.multUnits, config.multCycle + 2.0},
+        {memoryOps, (double)config.memoryUnits, memoryOps > 0 ? memoryHold / memoryOps : 0.0},
+        {branches, (double)config.branchUnits, config.branchCycle + 1.0},
+        {vadds + vmuls, (double)config.vectorUnits, vadds + vmuls > 0 ? vectorBusy / (vadds + vmuls) + 2.0 : 0.0}};
+    double window = n;
+    for (auto &c : classes)
+    {
+        if (c[0] == 0)
+            continue;
+        window = min(window, config.clusters * c[1] * n / c[0]);
+        ipc = min(ipc, config.clusters * c[1] * n / (c[0] * c[2]));
+    }
+    // The window slides: while one window drains along its chains the next one
+    // is already filling, so the chain bound is taken over twice the window.
+    window *= 2;
+    double level = min(max(log2(window), 0.0), (double)PROFILE_WINDOW_LEVELS - 1);
+    int low = (int)level;
+    int high = min(low + 1, PROFILE_WINDOW_LEVELS - 1);
+    // producer-to-consumer latency of each chain class, CDB cycle included
+    double classLatency[CHAIN_CLASSES] = {config.adderCycle + 1.0, config.multCycle + 1.0, config.memoryCycle + 2.0, (double)config.memoryCycle, (double)config.branchCycle};
+    double chainLatency = 0;
+    for (int c = 0; c < CHAIN_CLASSES; c++)
+    {
+        double links = profile.windowChain[low][c] + (level - low) * (profile.windowChain[high][c] - profile.windowChain[low][c]);
+        chainLatency += links * classLatency[c];
+    }
+    ipc = min(ipc, window / max(chainLatency, 1.0));
+
+    // A branch that stops issue costs its operand wait and resolution. Without
+    // speculation a predicted-taken branch only holds back execution behind it,
+    // as issue goes on.
+    bool predictTaken = config.isBranchTaken || profile.correctPath;
+    double mispredicted = profile.correctPath ? profile.notTakenBranches : (predictTaken ? 0 : branches);
+    double stallCycles = mispredicted * (latency + config.branchCycle);
+    if (!config.isSpeculative && predictTaken)
+        stallCycles += branches * config.branchCycle;
+    // plus filling and draining the pipeline once
+    double cpi = 1.0 / ipc + (stallCycles + latency + 2) / n;
+    return 1.0 / cpi;
+}
+
+// Steps the given simulators round-robin, one cycle each, so all of them walk the
+// shared trace together and its instructions are fetched into cache once.
+static void stepInterleaved(vector<TomsuloSimulator *> simulators)
+{
+    bool running = true;
+    while (running)
+    {
+        running = false;
+        for (auto simulator : simulators)
+        {
+            if (!simulator->isFinished())
+            {
+                running = simulator->step() || running;
+            }
+        }
+    }
+}
+
+// Runs every configuration over one shared trace. Configurations are dealt out to
+// threadCount host threads and each thread interleaves its share. Nothing runs
+// unless every configuration is valid for the trace.
+bool runBatch(const Trace *trace, vector<SimulatorConfig> &configs, int threadCount, vector<SimulationResult> &results, string &error)
+{
+    for (int i = 0; i < (int)configs.size(); i++)
+    {
+        if (!configs[i].validate(error) || !configs[i].fits(trace, error))
+        {
+            error = "config " + to_string(i) + ": " + error;
+            return false;
+        }
+    }
+
+    vector<TomsuloSimulator *> simulators;
+    for (auto &config : configs)
+    {
+        simulators.push_back(createSimulator(trace, config));
+    }
+
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > (int)simulators.size())
+        threadCount = simulators.size();
+
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        vector<TomsuloSimulator *> share;
+        for (int i = t; i < (int)simulators.size(); i += threadCount)
+        {
+            share.push_back(simulators[i]);
+        }
+        if (t == threadCount - 1)
+            stepInterleaved(share);
+        else
+            threads.push_back(thread(stepInterleaved, share));
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    results.clear();
+    for (auto simulator : simulators)
+    {
+        results.push_back(simulator->getResult());
+        delete simulator;
+    }
+    return true;
+}
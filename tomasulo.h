@@ -0,0 +1,2884 @@
+#ifndef TOMASULO_H
+#define TOMASULO_H
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <sstream>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+using namespace std;
+
+enum InstructionType
+{
+    NOP = 0, // NOP. Pipeline bubble.
+    ADD,     // Add
+    SUB,     // Subtract
+    MULT,    // Multiply
+    DIV,     // Divide
+    LW,      // Load word
+    SW,      // Store word
+    BNE,     // Branch not equal
+    VADD,    // Vector add, element-wise over vectorLength elements
+    VMUL,    // Vector multiply
+    VLW,     // Vector load of vectorLength consecutive words
+    VSW      // Vector store
+};
+
+enum ReservationStationType
+{
+    ADDDER = 0,
+    MULTDIV,
+    MEMORY,
+    BRANCH,
+    VECTOR
+};
+
+extern string ReservationStationTypeString[];
+
+enum Stage
+{
+    NOTISSUED = -1,
+    ISSUE = 0,
+    EXEC,
+    MEM,
+    WRITEBACK,
+    COMMIT,
+    FINISHED
+};
+
+// Register operands are numbered within their file; FP registers (written "f3")
+// are offset by FP_REGISTER_OFFSET so a single int names any register.
+const int FP_REGISTER_OFFSET = 1 << 16;
+// Vector registers ("v3") follow, offset by VECTOR_REGISTER_OFFSET.
+const int VECTOR_REGISTER_OFFSET = 2 << 16;
+
+// Position of a register operand in a file laid out int, then FP, then vector.
+inline int registerSlot(int operand, int intRegisters, int fpRegisters)
+{
+    if (operand >= VECTOR_REGISTER_OFFSET)
+        return intRegisters + fpRegisters + operand - VECTOR_REGISTER_OFFSET;
+    if (operand >= FP_REGISTER_OFFSET)
+        return intRegisters + operand - FP_REGISTER_OFFSET;
+    return operand;
+}
+
+inline bool isLoad(InstructionType type)
+{
+    return type == LW || type == VLW;
+}
+
+inline bool isStore(InstructionType type)
+{
+    return type == SW || type == VSW;
+}
+
+// Host-side self-profiling, built in with -DTOMASULO_PROFILE. Without it
+// PROFILE_SCOPE expands to nothing.
+#ifdef TOMASULO_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum ProfilePhase
+{
+    PROFILE_PARSE = 0,
+    PROFILE_RUN, // the whole cycle loop; what the phases below leave is issue and bookkeeping
+    PROFILE_EXECUTE,
+    PROFILE_EXEC_MEMORY,
+    PROFILE_WRITEBACK,
+    PROFILE_COMMIT,
+    PROFILE_ADVANCE,
+    PROFILE_SPECULATIVE_CLEAR,
+    PROFILE_PHASES
+};
+
+// Ticks and calls per phase, summed over every simulator and host thread.
+// Ticks are converted to ns against the steady clock over the process lifetime.
+struct HostProfile
+{
+    atomic<unsigned long long> ticks[PROFILE_PHASES], calls[PROFILE_PHASES];
+    unsigned long long startTicks;
+    chrono::steady_clock::time_point startTime;
+
+    HostProfile();
+    void report(long long instructions);
+
+    static unsigned long long now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+};
+
+extern HostProfile hostProfile;
+
+class ProfileScope
+{
+    ProfilePhase phase;
+    unsigned long long start;
+
+public:
+    ProfileScope(ProfilePhase phase)
+    {
+        this->phase = phase;
+        start = HostProfile::now();
+    }
+
+    ~ProfileScope()
+    {
+        hostProfile.ticks[phase].fetch_add(HostProfile::now() - start, memory_order_relaxed);
+        hostProfile.calls[phase].fetch_add(1, memory_order_relaxed);
+    }
+};
+
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(a, b) PROFILE_JOIN(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_NAME(profileScope, __LINE__)(phase)
+#else
+#define PROFILE_SCOPE(phase)
+#endif
+
+// One decoded instruction of a trace. Immutable once the trace is read, so a
+// single trace can be shared by any number of simulator runs and threads.
+class StaticInstruction
+{
+public:
+    StaticInstruction(string);
+
+    InstructionType type; // Type of instruction
+    int dest;             // Destination register number
+    int src1;             // Source register number
+    int src2;             // Source register number
+    string instructionString;
+
+    // Filled in by the FunctionalEngine when the trace is built.
+    int pc;            // line of the program this instruction came from
+    long long value;   // result written, loaded or stored
+    long long address; // load/store effective address, -1 otherwise
+    bool taken;        // BNE outcome
+};
+
+// The dynamic instruction stream of a program (loops already unrolled).
+class Trace
+{
+public:
+    Trace()
+    {
+        intRegistersUsed = 0;
+        fpRegistersUsed = 0;
+        vectorRegistersUsed = 0;
+        correctPath = false;
+    }
+
+    vector<StaticInstruction> instructions;
+    int intRegistersUsed, fpRegistersUsed, vectorRegistersUsed; // highest register number + 1 per file
+    // True when the stream follows the program's real control flow (functional
+    // mode), so each BNE carries its own outcome instead of isBranchTaken.
+    bool correctPath;
+};
+
+// Per-run timing state of one dynamic instruction.
+class Instruction
+{
+public:
+    Instruction();
+    Instruction(const StaticInstruction *, int);
+    int getId()
+    {
+        return id;
+    }
+    Stage getStage()
+    {
+        return stage;
+    }
+
+    // Copied from the decoded instruction so the hot loop does not chase it.
+    InstructionType type; // Type of instruction
+    int dest;             // Destination register number
+    int src1;             // Source register number
+    int src2;             // Source register number
+    string printInstruction()
+    {
+        return decoded->instructionString;
+    }
+    int issue;
+    int execStart;
+    int execEnd;
+    int memoryStart;
+    int memoryEnd;
+    int writeCDB;
+    int commit;
+    int id;
+    const StaticInstruction *decoded;
+    Stage stage;
+    bool fusedHead; // issued as one station together with the next instruction
+};
+
+class Register
+{
+public:
+    Register();
+    void clearDependencyValues(string dependentValue);
+    string dataValue; // takes reservation station number.
+    int registerNumber;
+    std::string registerName;
+};
+
+// Last-level cache/memory shared between simulated cores. Requests made during a
+// quantum are only counted; the queueing delay they cause is computed at the
+// quantum barrier and charged to every access of the next quantum, so results do
+// not depend on the order host threads reach the model.
+class SharedMemory
+{
+    int ports, quantum, quantumStart, penalty;
+    vector<atomic<int>> requests;
+    long long totalRequests, totalDelay;
+
+public:
+    SharedMemory(int ports, int quantum) : requests(quantum)
+    {
+        this->ports = ports;
+        this->quantum = quantum;
+        quantumStart = 0;
+        penalty = 0;
+        totalRequests = 0;
+        totalDelay = 0;
+        for (auto &r : requests)
+        {
+            r.store(0);
+        }
+    }
+
+    // Returns the extra cycles this access waits for a shared port.
+    int access(int cycleTime)
+    {
+        requests[cycleTime % quantum].fetch_add(1, memory_order_relaxed);
+        return penalty;
+    }
+
+    // Called once per quantum while every core is parked at the barrier.
+    void endQuantum()
+    {
+        long long quantumRequests = 0, quantumWait = 0;
+        int backlog = 0;
+        for (int i = 1; i <= quantum; i++)
+        {
+            atomic<int> &r = requests[(quantumStart + i) % quantum];
+            int count = r.load(memory_order_relaxed);
+            r.store(0, memory_order_relaxed);
+            quantumRequests += count;
+            backlog = max(0, backlog + count - ports);
+            quantumWait += backlog;
+        }
+        penalty = quantumRequests == 0 ? 0 : (int)((quantumWait + quantumRequests - 1) / quantumRequests);
+        totalRequests += quantumRequests;
+        totalDelay += quantumWait;
+        quantumStart += quantum;
+    }
+
+    long long getTotalRequests()
+    {
+        return totalRequests;
+    }
+
+    long long getTotalDelay()
+    {
+        return totalDelay;
+    }
+};
+
+class ReservationStation
+{
+    ReservationStationType type;
+    bool busy;
+    string op;
+    string vj;
+    string vk;
+    string qj;
+    string qk;
+    Instruction *instruction;
+    int cycleToComplete;
+
+public:
+    ReservationStation()
+    {
+        busy = false;
+        op = "";
+        vj = "";
+        vk = "";
+        qj = "";
+        qk = "";
+        instruction = NULL;
+        cycleToComplete = -1;
+    }
+
+    ReservationStation(Instruction *instr)
+    {
+        instruction = instr;
+        storeDependency = -1;
+        valuePredicted = false;
+        predictedValue = 0;
+        fused = NULL;
+        cluster = 0;
+        wokenBy = -1;
+    }
+
+    int storeDependency; // store this memory op was predicted to depend on, -1 if none
+    bool valuePredicted; // load whose dependents were woken with predictedValue at issue
+    long long predictedValue;
+    // Other half of a macro-fused pair sharing this station: the ADD/SUB ahead
+    // of a fused BNE, or the ADD/SUB consuming a fused LW. NULL if not fused.
+    Instruction *fused;
+    int cluster; // backend cluster the station was steered to
+    int wokenBy; // load whose speculative wakeup released this station, -1 if none
+
+    bool isInWriteBackStage()
+    {
+        return instruction->getStage() == WRITEBACK;
+    }
+
+    bool isInMemoryStage()
+    {
+        return instruction->getStage() == MEM;
+    }
+
+    bool isInExecStage()
+    {
+        return instruction->getStage() == EXEC;
+    }
+
+    bool isInIssueStage()
+    {
+        return instruction->getStage() == ISSUE;
+    }
+
+    int getIssueEndTime()
+    {
+        return instruction->issue;
+    }
+
+    void setStage(Stage stage)
+    {
+        instruction->stage = stage;
+        if (fused != NULL)
+            fused->stage = stage;
+    }
+
+    int getExecOrMemEndTime()
+    {
+        if ((isLoad(instruction->type) || isStore(instruction->type)) && instruction->memoryEnd != -1)
+        {
+            // a fused ADD finishes after the load it consumes
+            return fused != NULL ? fused->execEnd : instruction->memoryEnd;
+        }
+        // else if (instruction->type == SW && instruction->issue != -1)
+        // {
+        //     return instruction->issue;
+        // }
+        return instruction->execEnd;
+    }
+
+    int getWriteBackEndTime()
+    {
+        return instruction->writeCDB;
+    }
+
+    ReservationStationType getType()
+    {
+        return type;
+    }
+    void setType(ReservationStationType type)
+    {
+        this->type = type;
+    }
+    InstructionType getInstructionType()
+    {
+        return instruction->type;
+    }
+
+    int getId()
+    {
+        return instruction->getId();
+    }
+
+    bool hasDependency()
+    {
+        if (qj != "" || qk != "")
+            return true;
+        return false;
+    }
+    void setqj(string qj)
+    {
+        this->qj = qj;
+    }
+    void setqk(string qk)
+    {
+        this->qk = qk;
+    }
+    bool waitsFor(string reservationDependency)
+    {
+        return qj == reservationDependency || qk == reservationDependency;
+    }
+
+    void addDependency(string reservationDependency)
+    {
+        if (qj == "")
+            qj = reservationDependency;
+        else if (qk == "")
+            qk = reservationDependency;
+    }
+
+    void clearDependency(string reservationDependency)
+    {
+        // both operands may name the same producer, e.g. MULT r3 r1 r1
+        if (qj == reservationDependency)
+        {
+            qj = "";
+        }
+        if (qk == reservationDependency)
+        {
+            qk = "";
+        }
+    }
+
+    void setMemoryTiming(int startTime, int endTime)
+    {
+        instruction->memoryStart = startTime;
+        instruction->memoryEnd = endTime;
+    }
+
+    void setExecTiming(int startTime, int endTime)
+    {
+        instruction->execStart = startTime;
+        instruction->execEnd = endTime;
+    }
+
+    // Undoes an execution started on a misspeculated operand.
+    void resetExecution()
+    {
+        setExecTiming(-1, -1);
+        if (fused != NULL)
+        {
+            fused->execStart = -1;
+            fused->execEnd = -1;
+        }
+        setStage(EXEC);
+    }
+
+    void setWriteBackTiming(int time)
+    {
+        instruction->writeCDB = time;
+        if (fused != NULL)
+            fused->writeCDB = time;
+    }
+
+    Instruction *getInstruction()
+    {
+        return instruction;
+    }
+};
+
+struct compare
+{
+    bool operator()(Instruction *a, Instruction *b)
+    {
+        return a->getId() > b->getId();
+    }
+};
+
+struct SimulationStats
+{
+    long long branchMispredictions;
+    long long memoryOrderViolations;  // loads that read memory before an older store to the same address
+    long long falseDependencesAvoided; // loads that went past unresolved older stores to other addresses
+    long long loadsVerified;            // loads that finished their memory access
+    long long valuePredictions;         // of those, loads whose value was predicted
+    long long valuePredictionsCorrect;
+    long long valuePredictionCyclesSaved; // issue-to-writeback latency hidden by correct predictions
+    long long fusedPairs;                 // finished instruction pairs that issued as one station
+    long long crossClusterWakeups;        // consumers woken late by a producer in another cluster
+
+    long long prefetchesIssued;
+    long long prefetchesUseful; // prefetched lines a load later hit
+    long long prefetchesLate;   // of those, lines whose first load still waited for the data
+
+    long long retired;             // instructions committed (or finished, without a ROB)
+    long long branchStallCycles;   // cycles issue waited on an unresolved branch
+    long long memoryStallCycles;   // cycles a ready memory op could not start its access
+
+    // Activity counts for the energy model; squashed work is included.
+    long long issued, adderOps, multOps, branchOps, addressOps, memoryAccesses, cdbWrites, squashed;
+    long long vectorAddOps, vectorMultOps; // element operations of VADD and VMUL
+
+    long long loadWakeupsSpeculated; // loads whose consumers were woken assuming a hit
+    long long loadMisspeculations;   // of those, loads that did not broadcast in time
+    long long schedulerReplays;      // misspeculations that had consumers already started
+    long long wastedIssueSlots;      // executions thrown away by those replays
+
+    SimulationStats()
+    {
+        branchMispredictions = 0;
+        memoryOrderViolations = 0;
+        falseDependencesAvoided = 0;
+        loadsVerified = 0;
+        valuePredictions = 0;
+        valuePredictionsCorrect = 0;
+        valuePredictionCyclesSaved = 0;
+        fusedPairs = 0;
+        crossClusterWakeups = 0;
+        prefetchesIssued = prefetchesUseful = prefetchesLate = 0;
+        retired = branchStallCycles = memoryStallCycles = 0;
+        issued = adderOps = multOps = branchOps = addressOps = memoryAccesses = cdbWrites = squashed = 0;
+        vectorAddOps = vectorMultOps = 0;
+        loadWakeupsSpeculated = loadMisspeculations = schedulerReplays = wastedIssueSlots = 0;
+    }
+};
+
+enum PrefetcherMode
+{
+    PREFETCH_NONE = 0,
+    PREFETCH_NEXTLINE, // the lines after each load's line
+    PREFETCH_STRIDE    // per-pc stride table, once a stride repeats
+};
+
+// Prefetches lines ahead of the load stream into a small FIFO buffer. A load
+// whose line is in the buffer takes hitCycle instead of the full memoryCycle,
+// or waits only for what is left of the prefetch if it is still in flight.
+// Needs load addresses, so it only has an effect on functional traces.
+class Prefetcher
+{
+    struct StrideEntry
+    {
+        int pc;
+        long long lastAddress, stride;
+        bool confident;
+    };
+
+    PrefetcherMode mode;
+    int degree, distance, lineSize, bufferSize, hitCycle;
+    vector<StrideEntry> table;      // indexed by load pc
+    struct BufferedLine
+    {
+        int readyCycle; // cycle the prefetched data arrives
+        bool used;      // a load has hit it, so it counts as useful once
+    };
+
+    deque<long long> bufferOrder; // lines in insertion order, for eviction
+    unordered_map<long long, BufferedLine> buffer;
+
+    void prefetch(long long line, int readyCycle, SimulationStats &stats)
+    {
+        if (buffer.count(line))
+            return;
+        if ((int)bufferOrder.size() >= bufferSize)
+        {
+            buffer.erase(bufferOrder.front());
+            bufferOrder.pop_front();
+        }
+        BufferedLine prefetched = {readyCycle, false};
+        buffer[line] = prefetched;
+        bufferOrder.push_back(line);
+        stats.prefetchesIssued++;
+    }
+
+public:
+    Prefetcher(PrefetcherMode mode, int degree, int distance, int tableSize, int bufferSize, int lineSize, int hitCycle)
+    {
+        this->mode = mode;
+        this->degree = degree;
+        this->distance = distance;
+        this->bufferSize = bufferSize;
+        this->lineSize = lineSize;
+        this->hitCycle = hitCycle;
+        StrideEntry empty = {-1, 0, 0, false};
+        table.assign(tableSize, empty);
+    }
+
+    int getHitCycle()
+    {
+        return hitCycle;
+    }
+
+    // Latency of a load starting its access at startTime; trains the
+    // prefetcher and issues its next prefetches.
+    int access(int pc, long long address, int startTime, int memoryCycle, SimulationStats &stats)
+    {
+        if (address < 0)
+            return memoryCycle;
+
+        long long line = address / lineSize;
+        int latency = memoryCycle;
+        auto found = buffer.find(line);
+        if (found != buffer.end())
+        {
+            latency = max(hitCycle, found->second.readyCycle - startTime + 1);
+            if (!found->second.used)
+            {
+                found->second.used = true;
+                stats.prefetchesUseful++;
+                if (found->second.readyCycle > startTime)
+                    stats.prefetchesLate++;
+            }
+        }
+
+        int readyCycle = startTime + memoryCycle - 1;
+        if (mode == PREFETCH_NEXTLINE)
+        {
+            for (int i = 0; i < degree; i++)
+                prefetch(line + distance + i, readyCycle, stats);
+        }
+        else if (mode == PREFETCH_STRIDE)
+        {
+            StrideEntry &entry = table[pc % table.size()];
+            long long stride = address - entry.lastAddress;
+            entry.confident = entry.pc == pc && stride != 0 && stride == entry.stride;
+            entry.stride = entry.pc == pc ? stride : 0;
+            entry.pc = pc;
+            entry.lastAddress = address;
+            for (int i = 0; entry.confident && i < degree; i++)
+                prefetch((address + entry.stride * (distance + i)) / lineSize, readyCycle, stats);
+        }
+        return latency;
+    }
+};
+
+// Occupancy of the machine at the end of one cycle.
+struct CycleSample
+{
+    int add, mult, memory, branch, vec, rob;
+    bool branchStall, memoryStall;
+};
+
+// Aggregates CycleSamples into fixed-length intervals, written as CSV rows
+// and/or a progress line on stderr that is rewritten in place.
+class IntervalRecorder
+{
+    int interval, totalInstructions;
+    ofstream csv;
+    bool progress;
+    int cycles;
+    long long add, mult, memory, branch, vec, rob, branchStalls, memoryStalls;
+    long long retiredAtStart;
+
+    void reset(long long retired)
+    {
+        cycles = 0;
+        add = mult = memory = branch = vec = rob = branchStalls = memoryStalls = 0;
+        retiredAtStart = retired;
+    }
+
+    void writeInterval(int cycle, long long retired)
+    {
+        if (cycles == 0)
+            return;
+        double ipc = (double)(retired - retiredAtStart) / cycles;
+        if (csv.is_open())
+        {
+            csv << cycle << "," << ipc << "," << (double)add / cycles << "," << (double)mult / cycles << ","
+                << (double)memory / cycles << "," << (double)branch / cycles << "," << (double)vec / cycles << "," << (double)rob / cycles << ","
+                << branchStalls << "," << memoryStalls << endl;
+        }
+        if (progress)
+        {
+            cerr << "\rcycle " << cycle << ": " << retired << "/" << totalInstructions << " instructions ("
+                 << (totalInstructions ? 100 * retired / totalInstructions : 0) << "%), interval IPC " << ipc << "   " << flush;
+        }
+        reset(retired);
+    }
+
+public:
+    IntervalRecorder(int interval, string fileName, bool progress, int totalInstructions)
+    {
+        this->interval = interval;
+        this->progress = progress;
+        this->totalInstructions = totalInstructions;
+        if (fileName != "")
+        {
+            csv.open(fileName.c_str());
+            csv << "cycle,ipc,addStations,multStations,memoryStations,branchStations,vectorStations,rob,branchStallCycles,memoryStallCycles" << endl;
+        }
+        reset(0);
+    }
+
+    void sample(int cycle, CycleSample &s, long long retired)
+    {
+        cycles++;
+        add += s.add;
+        mult += s.mult;
+        memory += s.memory;
+        branch += s.branch;
+        vec += s.vec;
+        rob += s.rob;
+        branchStalls += s.branchStall;
+        memoryStalls += s.memoryStall;
+        if (cycles == interval)
+            writeInterval(cycle, retired);
+    }
+
+    // Writes the last, partial interval.
+    void finish(int cycle, long long retired)
+    {
+        writeInterval(cycle, retired);
+        if (progress)
+            cerr << endl;
+    }
+};
+
+// How loads are ordered against older stores whose access has not happened yet.
+enum MemoryDependenceMode
+{
+    MEMDEP_NONE = 0,     // no ordering and no checking (original model)
+    MEMDEP_CONSERVATIVE, // wait for every older store
+    MEMDEP_STORESET      // wait only for stores the store-set predictor names
+};
+
+// Macro-fusion rules, combined as a bit mask. The second instruction of a pair
+// must read the first one's destination.
+enum FusionRule
+{
+    FUSE_NONE = 0,
+    FUSE_ADD_BNE = 1, // ADD/SUB then BNE: one branch station, add and compare back to back
+    FUSE_LW_ADD = 2   // LW then ADD/SUB: one memory station, the add follows the access
+};
+
+// How issue picks a cluster for an instruction.
+enum SteeringPolicy
+{
+    STEER_ROUNDROBIN = 0, // next cluster in turn with a free station
+    STEER_LOADBALANCE,    // cluster with the fewest occupied stations of that class
+    STEER_DEPENDENCE      // cluster of a pending producer, else load balance
+};
+
+// A result broadcast that reaches some stations late: the other clusters',
+// or a load's consumers behind a deep scheduler.
+struct DelayedWakeup
+{
+    int cycle;    // cycle the tag reaches the stations
+    int producer; // instruction id, so a squash can drop it
+    int cluster;  // producer's cluster
+    bool remote;  // wakes the stations outside cluster, otherwise those in it
+    string tag;
+};
+
+enum LoadReplayMode
+{
+    REPLAY_NONE = 0, // load consumers wait for the broadcast, plus schedulerDepth
+    REPLAY_SELECTIVE, // woken assuming a hit; only consumers that started re-execute
+    REPLAY_FLUSH      // woken assuming a hit; a miss squashes from the oldest consumer that started
+};
+
+// A load whose consumers were woken for the cycle it would broadcast on a hit.
+struct LoadSpeculation
+{
+    Instruction *load;
+    int cycle;      // broadcast cycle assumed
+    bool delivered; // consumers have been woken
+};
+
+enum ValuePredictorMode
+{
+    VALUEPRED_NONE = 0,
+    VALUEPRED_LAST,  // predicts the value the load returned last time
+    VALUEPRED_STRIDE // last value plus the last observed difference
+};
+
+struct ValuePredictorEntry
+{
+    long long lastValue, stride;
+    int confidence; // 2-bit saturating counter
+
+    ValuePredictorEntry()
+    {
+        lastValue = 0;
+        stride = 0;
+        confidence = 0;
+    }
+};
+
+// Template argument of a specialized core meaning "read it from the configuration".
+const int RUNTIME_VARIANT = -1;
+
+// Speculative and Width are fixed at compile time for the common configurations
+// (see createSimulator) so the per-cycle checks on them fold away; the
+// RUNTIME_VARIANT instantiation handles everything else.
+template <int Speculative, int Width>
+class ReservationStationTable
+{
+protected:
+    vector<ReservationStation *> add, mult, branch, memory, vec;
+    int addUnits, multUnits, branchUnits, memoryUnits, vectorUnits;
+    // Units are per cluster; the memory port (isMemBusy) is shared by all of them.
+    bool isMemBusy;
+    int memoryPortFreeAt; // a vector store holds the port until this cycle
+    vector<bool> isMemExecBusy, isAdderBusy, isMultBusy, isBranchBusy, isVectorBusy;
+    // A vector op takes one pass through its unit per vectorLanes elements and
+    // one memory beat per vectorMemoryWidth elements.
+    int vectorLength, vectorBeats, vectorMemoryBeats;
+    int clusters, nextCluster, clusterBypassDelay;
+    SteeringPolicy steering;
+    deque<DelayedWakeup> delayedWakeups;
+    int memoryCycle, adderCycle, multCycle, branchCycle;
+    deque<int> branchInstrStallQueue;
+    bool isBranchTaken, isBranchEncountered;
+    bool correctPath;
+    int redirectBranch; // mispredicted branch that blocks issue until it resolves
+    bool isSpeculative, speculativeShouldExitOnBranch;
+    int ROBHead, branchIdExit;
+    priority_queue<Instruction *, vector<Instruction *>, compare> ROB;
+    int intRegisters, fpRegisters;
+    vector<Register> rf;                                  // int, then FP, then vector registers
+    unordered_map<string, vector<int>> waitingRegisters; // producer tag -> registers renamed to it
+    SharedMemory *sharedMemory;
+    Prefetcher *prefetcher;                 // NULL when disabled
+    bool memoryStalled;                     // set by execMemory for the current cycle
+    vector<ReservationStation *> allocated; // every station ever issued, freed with the table
+    SimulationStats stats;
+
+    // Store sets (Chrysos & Emer): the SSIT maps a load/store pc to a store set,
+    // the LFST maps a store set to its last issued, not yet performed store.
+    MemoryDependenceMode memoryDependence;
+    vector<int> storeSetIds, lastFetchedStore;
+    int nextStoreSet;
+    deque<Instruction *> accessedLoads; // loads that have read memory but not committed
+    int replayFrom;                     // oldest instruction squashed this cycle, -1 if none
+
+    ValuePredictorMode valuePredictor;
+    vector<ValuePredictorEntry> valuePredictorTable; // indexed by load pc
+    int valuePredictorThreshold;                     // confidence needed to predict
+    int fusionRules;                                 // FusionRule bits
+
+    // The wakeup/select loop takes schedulerDepth cycles. Fixed-latency producers
+    // hide it by waking their consumers early; a load's consumers either wait it
+    // out or are woken assuming a hit and replayed when the load is late.
+    int schedulerDepth;
+    LoadReplayMode loadReplay;
+    vector<LoadSpeculation> loadSpeculations;
+
+public:
+    ReservationStationTable()
+    {
+        setClusters(1, STEER_ROUNDROBIN, 0);
+        setVector(1, 1, 1, 1);
+        memoryCycle = adderCycle = multCycle = branchCycle = -1;
+        ROBHead = 0;
+        speculativeShouldExitOnBranch = false;
+        branchIdExit = -1;
+        sharedMemory = NULL;
+        prefetcher = NULL;
+        memoryStalled = false;
+        memoryStalled = false;
+        memoryDependence = MEMDEP_NONE;
+        nextStoreSet = 0;
+        replayFrom = -1;
+        valuePredictor = VALUEPRED_NONE;
+        valuePredictorThreshold = 2;
+        fusionRules = FUSE_NONE;
+        schedulerDepth = 0;
+        loadReplay = REPLAY_NONE;
+    }
+
+    ReservationStationTable(int addUnits, int multUnits, int branchUnits, int memoryUnits, int memoryCycle, int adderCycle, int multCycle, int branchCycle, bool isBranchTaken, bool isSpeculative, int intRegisters, int fpRegisters, int vectorRegisters, bool correctPath)
+    {
+        // On a correct-path trace every branch is predicted taken and a not-taken
+        // one just redirects fetch; the stream after it is still valid.
+        this->correctPath = correctPath;
+        redirectBranch = -1;
+        this->intRegisters = intRegisters;
+        this->fpRegisters = fpRegisters;
+        rf.resize(intRegisters + fpRegisters + vectorRegisters);
+        this->addUnits = addUnits;
+        this->multUnits = multUnits;
+        this->branchUnits = branchUnits;
+        this->memoryUnits = memoryUnits;
+        this->memoryCycle = memoryCycle;
+        this->adderCycle = adderCycle;
+        this->multCycle = multCycle;
+        this->branchCycle = branchCycle;
+        setClusters(1, STEER_ROUNDROBIN, 0);
+        setVector(1, 1, 1, 1);
+        this->isBranchTaken = isBranchTaken || correctPath;
+        isBranchEncountered = false;
+        this->isSpeculative = isSpeculative;
+        ROBHead = 0;
+        speculativeShouldExitOnBranch = false;
+        branchIdExit = -1;
+        sharedMemory = NULL;
+        prefetcher = NULL;
+        memoryDependence = MEMDEP_NONE;
+        nextStoreSet = 0;
+        replayFrom = -1;
+        valuePredictor = VALUEPRED_NONE;
+        valuePredictorThreshold = 2;
+        fusionRules = FUSE_NONE;
+        schedulerDepth = 0;
+        loadReplay = REPLAY_NONE;
+    }
+
+    ~ReservationStationTable()
+    {
+        for (auto station : allocated)
+        {
+            delete station;
+        }
+        delete prefetcher;
+    }
+
+    void setSharedMemory(SharedMemory *sharedMemory)
+    {
+        this->sharedMemory = sharedMemory;
+    }
+
+    SimulationStats &getStats()
+    {
+        return stats;
+    }
+
+    // Speculating past stores needs the ROB to squash a violation, so a
+    // non-speculative core orders its loads conservatively instead.
+    void setMemoryDependence(MemoryDependenceMode mode, int storeSetSize)
+    {
+        memoryDependence = mode;
+        if (mode == MEMDEP_STORESET && !speculative())
+            memoryDependence = MEMDEP_CONSERVATIVE;
+        storeSetIds.assign(storeSetSize, -1);
+        lastFetchedStore.assign(storeSetSize, -1);
+    }
+
+    // Value prediction is verified by squashing, so it needs a speculative core.
+    void setValuePredictor(ValuePredictorMode mode, int size, int threshold)
+    {
+        valuePredictor = speculative() ? mode : VALUEPRED_NONE;
+        valuePredictorTable.assign(size, ValuePredictorEntry());
+        valuePredictorThreshold = threshold;
+    }
+
+    // A flush replay needs the ROB, so a non-speculative core replays selectively.
+    void setScheduler(int depth, LoadReplayMode mode)
+    {
+        schedulerDepth = depth;
+        loadReplay = mode == REPLAY_FLUSH && !speculative() ? REPLAY_SELECTIVE : mode;
+    }
+
+    void setClusters(int count, SteeringPolicy policy, int bypassDelay)
+    {
+        clusters = count;
+        steering = policy;
+        clusterBypassDelay = bypassDelay;
+        nextCluster = 0;
+        isMemBusy = false;
+        memoryPortFreeAt = 0;
+        isMemExecBusy.assign(count, false);
+        isAdderBusy.assign(count, false);
+        isMultBusy.assign(count, false);
+        isBranchBusy.assign(count, false);
+        isVectorBusy.assign(count, false);
+    }
+
+    void setVector(int units, int length, int lanes, int memoryWidth)
+    {
+        vectorUnits = units;
+        vectorLength = length;
+        vectorBeats = (length + lanes - 1) / lanes;
+        vectorMemoryBeats = (length + memoryWidth - 1) / memoryWidth;
+    }
+
+    void setPrefetcher(Prefetcher *prefetcher)
+    {
+        this->prefetcher = prefetcher;
+    }
+
+    // Whether issue is held back by an unresolved branch (as opposed to full stations).
+    bool branchBlocksIssue()
+    {
+        return redirectBranch != -1 || (!speculative() && isBranchEncountered && !isBranchTaken) || (speculative() && speculativeShouldExitOnBranch);
+    }
+
+    CycleSample sample()
+    {
+        CycleSample s;
+        s.add = add.size();
+        s.mult = mult.size();
+        s.memory = memory.size();
+        s.branch = branch.size();
+        s.vec = vec.size();
+        s.rob = ROB.size();
+        s.branchStall = false;
+        s.memoryStall = memoryStalled;
+        return s;
+    }
+
+    void setFusionRules(int rules)
+    {
+        fusionRules = rules;
+    }
+
+    // Oldest instruction squashed since the last call, so the core can re-issue it.
+    int takeReplayPoint()
+    {
+        int from = replayFrom;
+        replayFrom = -1;
+        return from;
+    }
+
+    bool speculative()
+    {
+        return Speculative == RUNTIME_VARIANT ? isSpeculative : Speculative != 0;
+    }
+
+    int width(int configured)
+    {
+        return Width == RUNTIME_VARIANT ? configured : Width;
+    }
+
+    bool isEmpty()
+    {
+        return add.empty() && mult.empty() && branch.empty() && memory.empty() && vec.empty() && ROB.empty();
+    }
+
+    void commit(int cycleTime, int topK)
+    {
+        PROFILE_SCOPE(PROFILE_COMMIT);
+        for (int i = width(topK); i > 0; i--)
+        {
+            if (!ROB.empty() && ROB.top()->getId() != ROBHead)
+            {
+                //in order commit
+                break;
+            }
+
+            //else you can commit
+            if (!ROB.empty())
+            {
+                ROB.top()->stage = FINISHED;
+                ROB.top()->commit = cycleTime;
+                if (isStore(ROB.top()->type))
+                {
+                    ROB.top()->memoryStart = -1;
+                    ROB.top()->memoryEnd = -1;
+                }
+                ROB.pop();
+                ROBHead++;
+                stats.retired++;
+            }
+        }
+    }
+
+    void pushToROB(ReservationStation *station)
+    {
+        ROB.push(station->getInstruction());
+        if (station->fused != NULL)
+            ROB.push(station->fused);
+    }
+
+    void addAvailableWriteBackToMap(vector<ReservationStation *> iterateReservation, map<int, pair<ReservationStationType, int>> &availableToWriteBack, int cycleTime)
+    {
+        for (int i = 0; i < iterateReservation.size(); i++)
+        {
+
+            // a result computed from a speculatively woken operand waits for the load's check
+            if (iterateReservation[i]->isInWriteBackStage() && iterateReservation[i]->wokenBy == -1 && iterateReservation[i]->getExecOrMemEndTime() != -1 && iterateReservation[i]->getExecOrMemEndTime() < cycleTime)
+            {
+                pair<ReservationStationType, int> p;
+                p = make_pair(iterateReservation[i]->getType(), i + 1);
+                availableToWriteBack[iterateReservation[i]->getId()] = p;
+            }
+        }
+    }
+
+    void writeBack(int cycleTime, int topK)
+    {
+        PROFILE_SCOPE(PROFILE_WRITEBACK);
+        deliverWakeups(cycleTime);
+
+        map<int, pair<ReservationStationType, int>> availableToWriteBack;
+        // iterate over add reservation station
+        addAvailableWriteBackToMap(add, availableToWriteBack, cycleTime);
+        // iterate over mult reservation station
+        addAvailableWriteBackToMap(mult, availableToWriteBack, cycleTime);
+        // iterate over load reservation station
+        addAvailableWriteBackToMap(memory, availableToWriteBack, cycleTime);
+        addAvailableWriteBackToMap(vec, availableToWriteBack, cycleTime);
+
+        // clear write backs. Stations leave their table only after the loop so the
+        // indices recorded above stay valid.
+        vector<ReservationStation *> retired;
+        auto it = availableToWriteBack.begin();
+        for (int i = width(topK); i > 0 && it != availableToWriteBack.end(); i--, it++)
+        {
+            // make it finished
+            //EX : ADD1
+            string clearDependency = ReservationStationTypeString[it->second.first];
+            ReservationStation *producer = NULL;
+
+            //clear entry in table.
+            if (it->second.first == ADDDER)
+            {
+                //isAdderBusy = false;
+                producer = add[it->second.second - 1];
+                clearDependency += to_string(add[it->second.second - 1]->getInstruction()->id);
+                add[it->second.second - 1]
+                    ->setWriteBackTiming(cycleTime);
+                if (!speculative())
+                {
+                    add[it->second.second - 1]
+                        ->setStage(FINISHED);
+                    retired.push_back(add[it->second.second - 1]);
+                }
+            }
+            else if (it->second.first == MULTDIV)
+            {
+                //isMultBusy = false;
+                producer = mult[it->second.second - 1];
+                clearDependency += to_string(mult[it->second.second - 1]->getInstruction()->id);
+                mult[it->second.second - 1]->setWriteBackTiming(cycleTime);
+                if (!speculative())
+                {
+                    mult[it->second.second - 1]->setStage(FINISHED);
+                    retired.push_back(mult[it->second.second - 1]);
+                }
+            }
+            else if (it->second.first == MEMORY)
+            {
+                //isMemBusy = false;
+                producer = memory[it->second.second - 1];
+                clearDependency += to_string(memory[it->second.second - 1]->getInstruction()->id);
+                memory[it->second.second - 1]->setWriteBackTiming(cycleTime);
+                if (!speculative())
+                {
+                    memory[it->second.second - 1]->setStage(FINISHED);
+                    retired.push_back(memory[it->second.second - 1]);
+                }
+            }
+            else if (it->second.first == VECTOR)
+            {
+                producer = vec[it->second.second - 1];
+                clearDependency += to_string(producer->getInstruction()->id);
+                producer->setWriteBackTiming(cycleTime);
+                if (!speculative())
+                {
+                    producer->setStage(FINISHED);
+                    retired.push_back(producer);
+                }
+            }
+
+            broadcast(producer, clearDependency, cycleTime);
+            stats.cdbWrites++;
+        }
+
+        for (auto station : retired)
+        {
+            stats.retired += station->fused != NULL ? 2 : 1;
+            removeStation(station);
+        }
+
+        verifyLoadSpeculations(cycleTime);
+    }
+
+    void removeStation(ReservationStation *station)
+    {
+        vector<ReservationStation *> *tables[] = {&add, &mult, &memory, &branch, &vec};
+        for (auto table : tables)
+        {
+            auto found = find(table->begin(), table->end(), station);
+            if (found != table->end())
+            {
+                table->erase(found);
+                return;
+            }
+        }
+    }
+
+    void clearWriteBack(string reservationNumber)
+    {
+        clearReservationTableDependency(reservationNumber, add);
+        clearReservationTableDependency(reservationNumber, mult);
+        clearReservationTableDependency(reservationNumber, memory);
+        clearReservationTableDependency(reservationNumber, branch);
+        clearReservationTableDependency(reservationNumber, vec);
+        clearRegister(reservationNumber);
+    }
+
+    // Wakes the producer's own cluster now and every other cluster
+    // clusterBypassDelay cycles later; a load not woken speculatively adds
+    // schedulerDepth to both. The register file is updated at once.
+    void broadcast(ReservationStation *producer, string reservationNumber, int cycleTime)
+    {
+        int delay = loadReplay == REPLAY_NONE && isLoad(producer->getInstructionType()) && producer->fused == NULL ? schedulerDepth : 0;
+        int bypass = clusters > 1 ? clusterBypassDelay : 0;
+        if (delay == 0 && bypass == 0)
+        {
+            clearWriteBack(reservationNumber);
+            return;
+        }
+        if (delay == 0)
+        {
+            vector<ReservationStation *> *tables[] = {&add, &mult, &memory, &branch, &vec};
+            for (auto table : tables)
+            {
+                for (auto station : *table)
+                {
+                    if (station->cluster == producer->cluster)
+                        station->clearDependency(reservationNumber);
+                }
+            }
+        }
+        else
+        {
+            delayWakeup(producer, reservationNumber, cycleTime + delay, false);
+        }
+        clearRegister(reservationNumber);
+        if (clusters > 1)
+            delayWakeup(producer, reservationNumber, cycleTime + delay + bypass, true);
+    }
+
+    void delayWakeup(ReservationStation *producer, string tag, int cycle, bool remote)
+    {
+        DelayedWakeup wakeup;
+        wakeup.cycle = cycle;
+        wakeup.producer = producer->getId();
+        wakeup.cluster = producer->cluster;
+        wakeup.remote = remote;
+        wakeup.tag = tag;
+        delayedWakeups.push_back(wakeup);
+    }
+
+    void deliverWakeups(int cycleTime)
+    {
+        vector<ReservationStation *> *tables[] = {&add, &mult, &memory, &branch, &vec};
+        // wakeups with different delays interleave, so the whole list is checked
+        auto wakeup = delayedWakeups.begin();
+        while (wakeup != delayedWakeups.end())
+        {
+            if (wakeup->cycle > cycleTime)
+            {
+                wakeup++;
+                continue;
+            }
+            for (auto table : tables)
+            {
+                for (auto station : *table)
+                {
+                    if ((station->cluster != wakeup->cluster) == wakeup->remote && station->waitsFor(wakeup->tag))
+                    {
+                        station->clearDependency(wakeup->tag);
+                        if (wakeup->remote && clusterBypassDelay > 0)
+                            stats.crossClusterWakeups++;
+                    }
+                }
+            }
+            wakeup = delayedWakeups.erase(wakeup);
+        }
+
+        for (auto &speculation : loadSpeculations)
+        {
+            if (speculation.delivered || speculation.cycle > cycleTime)
+                continue;
+            speculation.delivered = true;
+            string tag = ReservationStationTypeString[MEMORY] + to_string(speculation.load->getId());
+            for (auto table : tables)
+            {
+                for (auto station : *table)
+                {
+                    // a station carries one speculation at a time; others wait for the broadcast
+                    if (station->wokenBy == -1 && station->waitsFor(tag))
+                    {
+                        station->clearDependency(tag);
+                        station->wokenBy = speculation.load->getId();
+                    }
+                }
+            }
+        }
+    }
+
+    // A load's hit or miss is known schedulerDepth cycles after its consumers
+    // were woken, or as soon as it broadcasts. On a miss the consumers that
+    // already started are replayed and the others wait for the broadcast again.
+    void verifyLoadSpeculations(int cycleTime)
+    {
+        vector<ReservationStation *> *tables[] = {&add, &mult, &memory, &branch, &vec};
+        int flushFrom = -1;
+        bool reset = false;
+        auto speculation = loadSpeculations.begin();
+        while (speculation != loadSpeculations.end())
+        {
+            Instruction *load = speculation->load;
+            bool arrived = load->writeCDB != -1;
+            if (!speculation->delivered || (!arrived && cycleTime < speculation->cycle + schedulerDepth))
+            {
+                speculation++;
+                continue;
+            }
+            bool hit = arrived && load->writeCDB <= speculation->cycle;
+            string tag = ReservationStationTypeString[MEMORY] + to_string(load->getId());
+            int started = 0;
+            for (auto table : tables)
+            {
+                for (auto station : *table)
+                {
+                    if (station->wokenBy != load->getId())
+                        continue;
+                    station->wokenBy = -1;
+                    if (hit)
+                        continue;
+                    bool executed = station->getInstruction()->execStart != -1;
+                    if (executed)
+                    {
+                        started++;
+                        if (loadReplay == REPLAY_FLUSH)
+                        {
+                            // a fused branch station carries the BNE's id; its ADD is older
+                            int oldest = station->fused != NULL ? min(station->getId(), station->fused->id) : station->getId();
+                            flushFrom = flushFrom == -1 ? oldest : min(flushFrom, oldest);
+                            continue;
+                        }
+                        station->resetExecution();
+                        reset = true;
+                    }
+                    if (!arrived)
+                        station->addDependency(tag);
+                }
+            }
+            if (!hit)
+            {
+                stats.loadMisspeculations++;
+                if (started > 0)
+                    stats.schedulerReplays++;
+                if (loadReplay == REPLAY_SELECTIVE)
+                    stats.wastedIssueSlots += started;
+            }
+            speculation = loadSpeculations.erase(speculation);
+        }
+
+        if (flushFrom != -1)
+        {
+            long long squashed = stats.squashed;
+            squashFrom(flushFrom);
+            stats.wastedIssueSlots += stats.squashed - squashed;
+        }
+        else if (reset)
+        {
+            rebuildUnitBusy();
+        }
+    }
+
+    void clearReservationTableDependency(string reservationNumber, vector<ReservationStation *> reservationStation)
+    {
+        for (auto reserv : reservationStation)
+        {
+            reserv->clearDependency(reservationNumber);
+        }
+    }
+
+    void clearRegister(string reservationNumber)
+    {
+        auto waiting = waitingRegisters.find(reservationNumber);
+        if (waiting == waitingRegisters.end())
+            return;
+
+        // a register renamed again since still lists this tag; the check inside skips it
+        for (int reg : waiting->second)
+        {
+            rf[reg].clearDependencyValues(reservationNumber);
+        }
+        waitingRegisters.erase(waiting);
+    }
+
+    int registerIndex(int operand)
+    {
+        return registerSlot(operand, intRegisters, fpRegisters);
+    }
+
+    void renameRegister(int operand, string producer)
+    {
+        int reg = registerIndex(operand);
+        rf[reg].dataValue = producer;
+        waitingRegisters[producer].push_back(reg);
+    }
+
+    bool storePending(int storeId)
+    {
+        for (auto station : memory)
+        {
+            if (station->getId() == storeId)
+                return true;
+        }
+        return false;
+    }
+
+    // Whether ordering rules keep this memory op from accessing memory yet.
+    bool mustWaitForStores(ReservationStation *op)
+    {
+        if (memoryDependence == MEMDEP_STORESET)
+        {
+            return op->storeDependency != -1 && storePending(op->storeDependency);
+        }
+        if (memoryDependence == MEMDEP_CONSERVATIVE && isLoad(op->getInstructionType()))
+        {
+            // stations are kept in program order
+            for (auto station : memory)
+            {
+                if (station == op)
+                    break;
+                if (isStore(station->getInstructionType()))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    int storeSetOf(Instruction *instr)
+    {
+        return storeSetIds[instr->decoded->pc % storeSetIds.size()];
+    }
+
+    void predictStoreDependence(ReservationStation *op)
+    {
+        int storeSet = storeSetOf(op->getInstruction());
+        if (storeSet == -1)
+            return;
+        op->storeDependency = lastFetchedStore[storeSet];
+        if (isStore(op->getInstructionType()))
+            lastFetchedStore[storeSet] = op->getId();
+    }
+
+    // Puts the load and the store in one store set, merging any sets they had.
+    void trainStoreSet(Instruction *store, Instruction *load)
+    {
+        int &storeSet = storeSetIds[store->decoded->pc % storeSetIds.size()];
+        int &loadSet = storeSetIds[load->decoded->pc % storeSetIds.size()];
+        if (storeSet == -1 && loadSet == -1)
+        {
+            storeSet = loadSet = nextStoreSet;
+            nextStoreSet = (nextStoreSet + 1) % storeSetIds.size();
+        }
+        else if (storeSet == -1)
+            storeSet = loadSet;
+        else if (loadSet == -1)
+            loadSet = storeSet;
+        else
+            storeSet = loadSet = min(storeSet, loadSet);
+    }
+
+    void loadAccessed(ReservationStation *load)
+    {
+        if (memoryDependence != MEMDEP_STORESET)
+            return;
+        accessedLoads.push_back(load->getInstruction());
+
+        bool bypassed = false;
+        for (auto station : memory)
+        {
+            if (station == load)
+                break;
+            if (isStore(station->getInstructionType()))
+            {
+                if (station->getInstruction()->decoded->address == load->getInstruction()->decoded->address)
+                    return; // a violation, counted when the store performs
+                bypassed = true;
+            }
+        }
+        if (bypassed)
+            stats.falseDependencesAvoided++;
+    }
+
+    // A store just wrote memory: any younger load to the same address that
+    // already read it got a stale value and is squashed along with everything after it.
+    void storePerformed(ReservationStation *store)
+    {
+        if (memoryDependence != MEMDEP_STORESET)
+            return;
+
+        Instruction *instr = store->getInstruction();
+        int storeSet = storeSetOf(instr);
+        if (storeSet != -1 && lastFetchedStore[storeSet] == instr->getId())
+            lastFetchedStore[storeSet] = -1;
+
+        pruneAccessedLoads();
+        Instruction *violator = NULL;
+        for (auto load : accessedLoads)
+        {
+            if (load->stage != NOTISSUED && load->stage != FINISHED && load->getId() > instr->getId() && load->memoryStart != -1 && load->decoded->address == instr->decoded->address && (violator == NULL || load->getId() < violator->getId()))
+            {
+                violator = load;
+            }
+        }
+        if (violator == NULL)
+            return;
+
+        stats.memoryOrderViolations++;
+        trainStoreSet(instr, violator);
+        squashFrom(violator->getId());
+    }
+
+    ValuePredictorEntry &valuePredictorEntry(Instruction *load)
+    {
+        return valuePredictorTable[load->decoded->pc % valuePredictorTable.size()];
+    }
+
+    // Called when the load is issued. Older loads from the same pc that are
+    // still in flight have not trained the entry yet, so a stride is applied
+    // once for each of them.
+    void predictLoadValue(ReservationStation *load)
+    {
+        ValuePredictorEntry &entry = valuePredictorEntry(load->getInstruction());
+        if (entry.confidence < valuePredictorThreshold)
+            return;
+
+        int inFlight = 0;
+        for (auto station : memory)
+        {
+            if (station != load && station->getInstructionType() == LW && station->getInstruction()->decoded->pc == load->getInstruction()->decoded->pc && station->getInstruction()->stage < WRITEBACK)
+                inFlight++;
+        }
+        load->valuePredicted = true;
+        load->predictedValue = entry.lastValue + (valuePredictor == VALUEPRED_STRIDE ? entry.stride * (inFlight + 1) : 0);
+    }
+
+    // The load's memory access finished: train the predictor and check the
+    // prediction. Returns false if dependents consumed a wrong value.
+    bool verifyLoadValue(ReservationStation *load)
+    {
+        Instruction *instr = load->getInstruction();
+        long long actual = instr->decoded->value;
+        ValuePredictorEntry &entry = valuePredictorEntry(instr);
+        long long expected = entry.lastValue + (valuePredictor == VALUEPRED_STRIDE ? entry.stride : 0);
+        entry.confidence = expected == actual ? min(entry.confidence + 1, 3) : 0;
+        entry.stride = actual - entry.lastValue;
+        entry.lastValue = actual;
+
+        stats.loadsVerified++;
+        if (!load->valuePredicted)
+            return true;
+
+        stats.valuePredictions++;
+        if (load->predictedValue == actual)
+        {
+            stats.valuePredictionsCorrect++;
+            stats.valuePredictionCyclesSaved += instr->memoryEnd + 1 - instr->issue;
+            return true;
+        }
+        // dependents replay and now have to wait for the real value
+        load->valuePredicted = false;
+        return false;
+    }
+
+    void execMemory(int cycleTime)
+    {
+        PROFILE_SCOPE(PROFILE_EXEC_MEMORY);
+        memoryStalled = false;
+        vector<ReservationStation *>::iterator it = memory.begin();
+        while (it != memory.end())
+        {
+            int timing;
+            if (isLoad((*it)->getInstructionType()))
+            {
+                timing = (*it)->getExecOrMemEndTime();
+            }
+            else
+            {
+                timing = (*it)->getIssueEndTime();
+            }
+
+            bool ready = (*it)->isInMemoryStage() && !(*it)->hasDependency() && (*it)->wokenBy == -1 && timing != -1 && timing < cycleTime;
+            if (ready && (isMemBusy || cycleTime < memoryPortFreeAt || mustWaitForStores(*it)))
+            {
+                memoryStalled = true;
+            }
+            else if (ready)
+            {
+                isMemBusy = true;
+                int startTime = cycleTime;
+                if (sharedMemory != NULL)
+                {
+                    startTime += sharedMemory->access(cycleTime);
+                }
+                int latency = memoryCycle;
+                int beats = 1;
+                if ((*it)->getInstructionType() == VLW || (*it)->getInstructionType() == VSW)
+                {
+                    beats = vectorMemoryBeats;
+                    latency = memoryCycle * beats;
+                }
+                if (loadReplay != REPLAY_NONE && isLoad((*it)->getInstructionType()) && (*it)->fused == NULL && !(*it)->valuePredicted && (*it)->getInstruction()->dest != -1)
+                {
+                    // the scheduler assumes no contention and, with a prefetcher, a buffer hit
+                    int hitLatency = prefetcher != NULL && (*it)->getInstructionType() == LW ? prefetcher->getHitCycle() : latency;
+                    LoadSpeculation speculation = {(*it)->getInstruction(), cycleTime + hitLatency, false};
+                    loadSpeculations.push_back(speculation);
+                    stats.loadWakeupsSpeculated++;
+                }
+                if (prefetcher != NULL && (*it)->getInstructionType() == LW)
+                {
+                    const StaticInstruction *decoded = (*it)->getInstruction()->decoded;
+                    latency = prefetcher->access(decoded->pc, decoded->address, startTime, memoryCycle, stats);
+                }
+                (*it)->setMemoryTiming(startTime, startTime + latency - 1);
+                stats.memoryAccesses += beats;
+                if ((*it)->getInstructionType() == VSW)
+                {
+                    // a scalar store frees the port at once; a vector one keeps
+                    // it for every beat but its last
+                    memoryPortFreeAt = startTime + latency - memoryCycle + 1;
+                }
+                if ((*it)->fused != NULL)
+                {
+                    stats.adderOps++;
+                    // the fused add keeps the memory pipeline until it is done
+                    (*it)->fused->execStart = startTime + latency;
+                    (*it)->fused->execEnd = startTime + latency + adderCycle - 1;
+                }
+
+                if (isLoad((*it)->getInstructionType()))
+                {
+                    loadAccessed(*it);
+                }
+                else if (isStore((*it)->getInstructionType()) && !speculative())
+                {
+
+                    // if non-speculative
+                    (*it)->setStage(FINISHED);
+                    stats.retired++;
+                    memory.erase(it);
+                    isMemBusy = false;
+                }
+                else if (speculative() && isStore((*it)->getInstructionType()))
+                {
+                    ReservationStation *store = *it;
+                    store->setStage(COMMIT);
+                    isMemBusy = false;
+                    ROB.push(store->getInstruction());
+                    memory.erase(it);
+                    storePerformed(store);
+                }
+                break;
+            }
+
+            it++;
+        }
+    }
+
+    void execute(int cycleTime)
+    {
+        PROFILE_SCOPE(PROFILE_EXECUTE);
+        // 1. LOAD
+        for (auto it : memory)
+        {
+            if (!isMemExecBusy[it->cluster] && it->isInExecStage() && !it->hasDependency() && it->getIssueEndTime() != -1 && it->getIssueEndTime() < cycleTime)
+            {
+                isMemExecBusy[it->cluster] = true;
+                it->setExecTiming(cycleTime, cycleTime);
+                stats.addressOps++;
+            }
+        }
+
+        //2. ADD
+        for (auto it : add)
+        {
+            if (!isAdderBusy[it->cluster] && it->isInExecStage() && !it->hasDependency() && it->getIssueEndTime() != -1 && it->getIssueEndTime() < cycleTime)
+            {
+                isAdderBusy[it->cluster] = true;
+                it->setExecTiming(cycleTime, cycleTime + adderCycle - 1);
+                stats.adderOps++;
+            }
+        }
+
+        //3. MULT
+        for (auto it : mult)
+        {
+            if (!isMultBusy[it->cluster] && it->isInExecStage() && !it->hasDependency() && it->getIssueEndTime() != -1 && it->getIssueEndTime() < cycleTime)
+            {
+                isMultBusy[it->cluster] = true;
+                it->setExecTiming(cycleTime, cycleTime + multCycle - 1);
+                stats.multOps++;
+            }
+        }
+
+        //4. Branch
+        for (auto it : branch)
+        {
+            if (!isBranchBusy[it->cluster] && it->isInExecStage() && !it->hasDependency() && it->getIssueEndTime() != -1 && it->getIssueEndTime() < cycleTime)
+            {
+                isBranchBusy[it->cluster] = true;
+                int start = cycleTime;
+                if (it->fused != NULL)
+                {
+                    it->fused->execStart = cycleTime;
+                    it->fused->execEnd = cycleTime + adderCycle - 1;
+                    start += adderCycle;
+                    stats.adderOps++;
+                }
+                it->setExecTiming(start, start + branchCycle - 1);
+                stats.branchOps++;
+            }
+        }
+
+        //5. Vector
+        for (auto it : vec)
+        {
+            if (!isVectorBusy[it->cluster] && it->isInExecStage() && !it->hasDependency() && it->getIssueEndTime() != -1 && it->getIssueEndTime() < cycleTime)
+            {
+                isVectorBusy[it->cluster] = true;
+                bool isAdd = it->getInstructionType() == VADD;
+                it->setExecTiming(cycleTime, cycleTime + (isAdd ? adderCycle : multCycle) * vectorBeats - 1);
+                (isAdd ? stats.vectorAddOps : stats.vectorMultOps) += vectorLength;
+            }
+        }
+    }
+
+    bool canIssue(InstructionType instructionType)
+    {
+        if (redirectBranch != -1)
+        {
+            return false;
+        }
+
+        if ((!speculative()) && ((isBranchEncountered) && (!isBranchTaken)))
+        {
+            // if branch is not taken, don't issue any instruction after branch
+            return false;
+        }
+
+        if (speculative() && speculativeShouldExitOnBranch)
+        {
+            return false;
+        }
+
+        if (isLoad(instructionType) || isStore(instructionType))
+        {
+            return hasFreeStation(memory, memoryUnits);
+        }
+        else if (instructionType == VADD || instructionType == VMUL)
+        {
+            return hasFreeStation(vec, vectorUnits);
+        }
+        else if (instructionType == ADD || instructionType == SUB)
+        {
+            return hasFreeStation(add, addUnits);
+        }
+        else if (instructionType == MULT || instructionType == DIV)
+        {
+            return hasFreeStation(mult, multUnits);
+        }
+        else if (instructionType == BNE)
+        {
+            isBranchEncountered = true;
+            return hasFreeStation(branch, branchUnits);
+        }
+    }
+
+    vector<int> clusterOccupancy(vector<ReservationStation *> &table)
+    {
+        vector<int> used(clusters, 0);
+        for (auto station : table)
+            used[station->cluster]++;
+        return used;
+    }
+
+    bool hasFreeStation(vector<ReservationStation *> &table, int units)
+    {
+        if (clusters == 1)
+            return (int)table.size() < units;
+        vector<int> used = clusterOccupancy(table);
+        return *min_element(used.begin(), used.end()) < units;
+    }
+
+    int producerCluster(string tag)
+    {
+        int id = atoi(tag.c_str() + tag.find_first_of("0123456789"));
+        vector<ReservationStation *> *tables[] = {&add, &mult, &memory, &branch, &vec};
+        for (auto table : tables)
+        {
+            for (auto station : *table)
+            {
+                if (station->getId() == id)
+                    return station->cluster;
+            }
+        }
+        return -1;
+    }
+
+    // Picks the cluster for a new station of this class; canIssue has already
+    // checked that one of them has room.
+    int steer(Instruction *instr, vector<ReservationStation *> &table, int units)
+    {
+        if (clusters == 1)
+            return 0;
+        vector<int> used = clusterOccupancy(table);
+        if (steering == STEER_DEPENDENCE)
+        {
+            int sources[] = {instr->src1, instr->src2};
+            for (int source : sources)
+            {
+                if (source == -1 || rf[registerIndex(source)].dataValue == "")
+                    continue;
+                int cluster = producerCluster(rf[registerIndex(source)].dataValue);
+                if (cluster != -1 && used[cluster] < units)
+                    return cluster;
+            }
+        }
+        else if (steering == STEER_ROUNDROBIN)
+        {
+            for (int i = 0; i < clusters; i++)
+            {
+                int cluster = (nextCluster + i) % clusters;
+                if (used[cluster] < units)
+                {
+                    nextCluster = (cluster + 1) % clusters;
+                    return cluster;
+                }
+            }
+        }
+        int chosen = -1;
+        for (int cluster = 0; cluster < clusters; cluster++)
+        {
+            if (used[cluster] < units && (chosen == -1 || used[cluster] < used[chosen]))
+                chosen = cluster;
+        }
+        return chosen;
+    }
+
+    // Station type a pair issues into, or -1 if the enabled rules do not fuse it.
+    // The fused station holds two operand tags, so a pair needing three waits.
+    int fusionType(Instruction *head, Instruction *tail)
+    {
+        if (head->dest == -1 || (tail->src1 != head->dest && tail->src2 != head->dest))
+            return -1;
+        int type = -1;
+        if ((fusionRules & FUSE_ADD_BNE) && (head->type == ADD || head->type == SUB) && tail->type == BNE)
+            type = BRANCH;
+        if ((fusionRules & FUSE_LW_ADD) && head->type == LW && (tail->type == ADD || tail->type == SUB))
+            type = MEMORY;
+        if (type == -1 || fusedOperandTags(head, tail).size() > 2)
+            return -1;
+        return type;
+    }
+
+    vector<string> fusedOperandTags(Instruction *head, Instruction *tail)
+    {
+        int sources[] = {head->src1, head->src2, tail->src1 == head->dest ? tail->src2 : tail->src1};
+        vector<string> tags;
+        for (int source : sources)
+        {
+            if (source == -1)
+                continue;
+            string tag = rf[registerIndex(source)].dataValue;
+            if (tag != "" && find(tags.begin(), tags.end(), tag) == tags.end())
+                tags.push_back(tag);
+        }
+        return tags;
+    }
+
+    // Issues two adjacent instructions as one station. A fused branch keeps the
+    // branch's id so squashes and redirects treat the pair as the branch.
+    void issueFused(Instruction *head, Instruction *tail, int cycleTime)
+    {
+        head->issue = tail->issue = cycleTime;
+        stats.issued += 2;
+        head->stage = tail->stage = ISSUE;
+        ReservationStation *station;
+        if (tail->type == BNE)
+        {
+            station = new ReservationStation(tail);
+            station->fused = head;
+            station->setType(BRANCH);
+            station->cluster = steer(head, branch, branchUnits);
+            branch.push_back(station);
+        }
+        else
+        {
+            station = new ReservationStation(head);
+            station->fused = tail;
+            station->setType(MEMORY);
+            station->cluster = steer(head, memory, memoryUnits);
+            memory.push_back(station);
+            if (memoryDependence == MEMDEP_STORESET)
+            {
+                predictStoreDependence(station);
+            }
+        }
+        allocated.push_back(station);
+        head->fusedHead = true;
+
+        vector<string> tags = fusedOperandTags(head, tail);
+        if (tags.size() > 0)
+            station->setqj(tags[0]);
+        if (tags.size() > 1)
+            station->setqk(tags[1]);
+
+        string tag = ReservationStationTypeString[station->getType()] + to_string(station->getId());
+        renameRegister(head->dest, tag);
+        if (tail->dest != -1)
+            renameRegister(tail->dest, tag);
+
+        if (tail->type == BNE)
+        {
+            if (!speculative())
+            {
+                branchInstrStallQueue.push_back(cycleTime);
+            }
+            else if (correctPath && !tail->decoded->taken)
+            {
+                redirectBranch = tail->id;
+            }
+        }
+    }
+
+    void issue(Instruction *instr, int cycleTime)
+    {
+        instr->issue = cycleTime;
+        stats.issued++;
+        instr->stage = ISSUE;
+        if (isLoad(instr->type) || isStore(instr->type))
+        {
+            ReservationStation *mem = new ReservationStation(instr);
+            mem->setType(MEMORY);
+            mem->cluster = steer(instr, memory, memoryUnits);
+            memory.push_back(mem);
+            if (memoryDependence == MEMDEP_STORESET)
+            {
+                predictStoreDependence(mem);
+            }
+            if (valuePredictor != VALUEPRED_NONE && instr->type == LW)
+            {
+                predictLoadValue(mem);
+            }
+            allocated.push_back(mem);
+            if (instr->src1 != -1 && rf[registerIndex(instr->src1)].dataValue != "")
+            {
+                mem->setqj(rf[registerIndex(instr->src1)].dataValue);
+            }
+            if (instr->src2 != -1 && rf[registerIndex(instr->src2)].dataValue != "")
+            {
+                mem->setqk(rf[registerIndex(instr->src2)].dataValue);
+            }
+
+            if (mem->valuePredicted)
+            {
+                // dependents take the predicted value instead of waiting for this load
+                rf[registerIndex(instr->dest)].dataValue = "";
+            }
+            else if (instr->dest != -1)
+            {
+                renameRegister(instr->dest, ReservationStationTypeString[MEMORY] + to_string(instr->id));
+            }
+        }
+        else if (instr->type == ADD || instr->type == SUB)
+        {
+            ReservationStation *adder = new ReservationStation(instr);
+            adder->setType(ADDDER);
+            adder->cluster = steer(instr, add, addUnits);
+            add.push_back(adder);
+            allocated.push_back(adder);
+            if (instr->src1 != -1 && rf[registerIndex(instr->src1)].dataValue != "")
+            {
+                adder->setqj(rf[registerIndex(instr->src1)].dataValue);
+            }
+            if (instr->src2 != -1 && rf[registerIndex(instr->src2)].dataValue != "")
+            {
+                adder->setqk(rf[registerIndex(instr->src2)].dataValue);
+            }
+
+            if (instr->dest != -1)
+            {
+                renameRegister(instr->dest, ReservationStationTypeString[ADDDER] + to_string(instr->id));
+            }
+        }
+        else if (instr->type == MULT || instr->type == DIV)
+        {
+            ReservationStation *multDiv = new ReservationStation(instr);
+            multDiv->setType(MULTDIV);
+            multDiv->cluster = steer(instr, mult, multUnits);
+            mult.push_back(multDiv);
+            allocated.push_back(multDiv);
+            if (instr->src1 != -1 && rf[registerIndex(instr->src1)].dataValue != "")
+            {
+                multDiv->setqj(rf[registerIndex(instr->src1)].dataValue);
+            }
+            if (instr->src2 != -1 && rf[registerIndex(instr->src2)].dataValue != "")
+            {
+                multDiv->setqk(rf[registerIndex(instr->src2)].dataValue);
+            }
+
+            if (instr->dest != -1)
+            {
+                renameRegister(instr->dest, ReservationStationTypeString[MULTDIV] + to_string(instr->id));
+            }
+        }
+        else if (instr->type == VADD || instr->type == VMUL)
+        {
+            ReservationStation *vectorOp = new ReservationStation(instr);
+            vectorOp->setType(VECTOR);
+            vectorOp->cluster = steer(instr, vec, vectorUnits);
+            vec.push_back(vectorOp);
+            allocated.push_back(vectorOp);
+            if (instr->src1 != -1 && rf[registerIndex(instr->src1)].dataValue != "")
+            {
+                vectorOp->setqj(rf[registerIndex(instr->src1)].dataValue);
+            }
+            if (instr->src2 != -1 && rf[registerIndex(instr->src2)].dataValue != "")
+            {
+                vectorOp->setqk(rf[registerIndex(instr->src2)].dataValue);
+            }
+
+            if (instr->dest != -1)
+            {
+                renameRegister(instr->dest, ReservationStationTypeString[VECTOR] + to_string(instr->id));
+            }
+        }
+        else if (instr->type == BNE)
+        {
+            ReservationStation *br = new ReservationStation(instr);
+            br->setType(BRANCH);
+            br->cluster = steer(instr, branch, branchUnits);
+            branch.push_back(br);
+            allocated.push_back(br);
+            if (instr->src1 != -1 && rf[registerIndex(instr->src1)].dataValue != "")
+            {
+                br->setqj(rf[registerIndex(instr->src1)].dataValue);
+            }
+            if (instr->src2 != -1 && rf[registerIndex(instr->src2)].dataValue != "")
+            {
+                br->setqk(rf[registerIndex(instr->src2)].dataValue);
+            }
+
+            if (!speculative())
+            {
+                branchInstrStallQueue.push_back(instr->issue);
+            }
+            else if (correctPath && !instr->decoded->taken)
+            {
+                redirectBranch = instr->id;
+            }
+        }
+    }
+
+    void advanceStage(int cycleTime)
+    {
+        PROFILE_SCOPE(PROFILE_ADVANCE);
+
+        //6. Writeback to commit
+        advanceFromWriteBack(cycleTime, add);
+        advanceFromWriteBack(cycleTime, mult);
+        advanceFromWriteBack(cycleTime, memory);
+        advanceFromWriteBack(cycleTime, vec);
+
+        //5. Branch case
+        vector<ReservationStation *>::iterator it = branch.begin();
+        while (it != branch.end())
+        {
+            if ((*it)->isInExecStage() && (*it)->wokenBy == -1 && (*it)->getExecOrMemEndTime() != -1 && (*it)->getExecOrMemEndTime() <= cycleTime && isBranchBusy[(*it)->cluster])
+            {
+                isBranchBusy[(*it)->cluster] = false;
+                if ((*it)->getId() == redirectBranch)
+                {
+                    redirectBranch = -1;
+                    stats.branchMispredictions++;
+                }
+                if (!speculative())
+                {
+                    (*it)->setStage(FINISHED);
+                    stats.retired += (*it)->fused != NULL ? 2 : 1;
+
+                    // remove stall
+                    branchInstrStallQueue.pop_front();
+                }
+
+                if ((*it)->fused != NULL)
+                {
+                    // the fused ADD's result leaves with the branch outcome
+                    (*it)->setWriteBackTiming(cycleTime);
+                    broadcast(*it, ReservationStationTypeString[BRANCH] + to_string((*it)->getId()), cycleTime);
+                }
+
+                if (speculative() && isBranchTaken)
+                {
+                    (*it)->setStage(COMMIT);
+                    pushToROB(*it);
+                }
+                else if (speculative() && !isBranchTaken)
+                {
+                    (*it)->setStage(COMMIT);
+                    pushToROB(*it);
+                    branchIdExit = (*it)->getInstruction()->getId();
+                    speculativeShouldExitOnBranch = true;
+                }
+
+                //remove branch instr from queue
+                branch.erase(it);
+                break;
+            }
+            it++;
+        }
+
+        //4. Exec to WriteBack
+        advanceFromExecStage(cycleTime, add);
+        advanceFromExecStage(cycleTime, mult);
+        advanceFromExecStage(cycleTime, vec);
+
+        // 3. Memory to WriteBack
+        int valueMispredicted = -1;
+        for (auto it : memory)
+        {
+            if ((it)->isInMemoryStage() && (it)->getInstruction()->memoryEnd != -1 && (it)->getExecOrMemEndTime() <= cycleTime)
+            {
+
+                (it)->setStage(WRITEBACK);
+                isMemBusy = false;
+                if (valuePredictor != VALUEPRED_NONE && it->getInstructionType() == LW && !verifyLoadValue(it) && valueMispredicted == -1)
+                {
+                    valueMispredicted = it->getId();
+                }
+            }
+
+            it++;
+        }
+        if (valueMispredicted != -1)
+        {
+            squashFrom(valueMispredicted + 1);
+        }
+
+        // 2. Exec to memory
+        for (auto it : memory)
+        {
+            if (!isStore(it->getInstructionType()) && it->isInExecStage() && it->getExecOrMemEndTime() != -1 && it->getExecOrMemEndTime() <= cycleTime)
+            {
+                it->setStage(MEM);
+                isMemExecBusy[it->cluster] = false;
+            }
+        }
+
+        // 1. Issue to Exec/ MEM
+        advanceFromIssueStage(cycleTime, memory);
+        advanceFromIssueStage(cycleTime, add);
+        advanceFromIssueStage(cycleTime, mult);
+        advanceFromIssueStage(cycleTime, branch);
+        advanceFromIssueStage(cycleTime, vec);
+    }
+
+    void advanceFromIssueStage(int cycleTime, vector<ReservationStation *> resrv)
+    {
+        for (auto it : resrv)
+        {
+            if (((!branchInstrStallQueue.empty() && it->getIssueEndTime() <= branchInstrStallQueue.front()) || (branchInstrStallQueue.empty())) && !isStore(it->getInstructionType()) && it->isInIssueStage() && it->getIssueEndTime() <= cycleTime)
+            {
+                it->setStage(EXEC);
+            }
+
+            if (((!branchInstrStallQueue.empty() && it->getIssueEndTime() <= branchInstrStallQueue.front()) || (branchInstrStallQueue.empty())) && isStore(it->getInstructionType()) && it->isInIssueStage() && it->getIssueEndTime() <= cycleTime)
+            {
+                it->setStage(MEM);
+            }
+        }
+    }
+
+    void advanceFromExecStage(int cycleTime, vector<ReservationStation *> resrv)
+    {
+        for (auto it : resrv)
+        {
+            if (it->isInExecStage() && it->getExecOrMemEndTime() != -1 && it->getExecOrMemEndTime() <= cycleTime)
+            {
+                it->setStage(WRITEBACK);
+                if (it->getInstructionType() == ADD || it->getInstructionType() == SUB)
+                    isAdderBusy[it->cluster] = false;
+                if (it->getInstructionType() == MULT || it->getInstructionType() == DIV)
+                    isMultBusy[it->cluster] = false;
+                if (it->getInstructionType() == VADD || it->getInstructionType() == VMUL)
+                    isVectorBusy[it->cluster] = false;
+            }
+        }
+    }
+
+    void advanceFromWriteBack(int cycleTime, vector<ReservationStation *> &resrv)
+    {
+        vector<ReservationStation *>::iterator it = resrv.begin();
+
+        while (it != resrv.end())
+        {
+            if ((*it)->isInWriteBackStage() && (*it)->getWriteBackEndTime() != -1 && (*it)->getWriteBackEndTime() <= cycleTime)
+            {
+                (*it)->setStage(COMMIT);
+                pushToROB(*it);
+                resrv.erase(it);
+            }
+            else
+                it++;
+        }
+    }
+
+    void speculativeReservationClear()
+    {
+        PROFILE_SCOPE(PROFILE_SPECULATIVE_CLEAR);
+        if (!speculativeShouldExitOnBranch || branchIdExit == -1)
+            return;
+
+        speculativeClear(add);
+        speculativeClear(mult);
+        speculativeClear(branch);
+        speculativeClear(memory);
+        speculativeClear(vec);
+        int lastKept = branchIdExit;
+        loadSpeculations.erase(remove_if(loadSpeculations.begin(), loadSpeculations.end(), [lastKept](const LoadSpeculation &l) { return l.load->getId() > lastKept; }), loadSpeculations.end());
+
+        while (!ROB.empty() && ROB.top()->getId() > branchIdExit)
+        {
+            ROB.top()->stage = NOTISSUED;
+            ROB.pop();
+            stats.squashed++;
+        }
+    }
+
+    void pruneAccessedLoads()
+    {
+        while (!accessedLoads.empty() && (accessedLoads.front()->stage == FINISHED || accessedLoads.front()->stage == NOTISSUED))
+        {
+            accessedLoads.pop_front();
+        }
+    }
+
+    // Squashes instruction id and everything younger, restoring rename and unit
+    // state as if they had never issued. The core re-issues them (takeReplayPoint).
+    void squashFrom(int id)
+    {
+        speculativeClear(add, id - 1);
+        speculativeClear(mult, id - 1);
+        speculativeClear(branch, id - 1);
+        speculativeClear(memory, id - 1);
+        speculativeClear(vec, id - 1);
+
+        vector<Instruction *> kept;
+        while (!ROB.empty())
+        {
+            if (ROB.top()->getId() < id)
+                kept.push_back(ROB.top());
+            else
+            {
+                ROB.top()->stage = NOTISSUED;
+                stats.squashed++;
+            }
+            ROB.pop();
+        }
+        for (auto instr : kept)
+        {
+            ROB.push(instr);
+        }
+
+        pruneAccessedLoads();
+        delayedWakeups.erase(remove_if(delayedWakeups.begin(), delayedWakeups.end(), [id](const DelayedWakeup &w) { return w.producer >= id; }), delayedWakeups.end());
+        loadSpeculations.erase(remove_if(loadSpeculations.begin(), loadSpeculations.end(), [id](const LoadSpeculation &l) { return l.load->getId() >= id; }), loadSpeculations.end());
+        for (auto &store : lastFetchedStore)
+        {
+            if (store >= id)
+                store = -1;
+        }
+        if (redirectBranch >= id)
+            redirectBranch = -1;
+        if (branchIdExit >= id)
+        {
+            branchIdExit = -1;
+            speculativeShouldExitOnBranch = false;
+        }
+
+        rebuildAfterSquash();
+        replayFrom = replayFrom == -1 ? id : min(replayFrom, id);
+    }
+
+    // Busy flags of the units whose stations are mid-execution or mid-access.
+    void rebuildUnitBusy()
+    {
+        isMemBusy = false;
+        isAdderBusy.assign(clusters, false);
+        isMultBusy.assign(clusters, false);
+        isBranchBusy.assign(clusters, false);
+        isVectorBusy.assign(clusters, false);
+        isMemExecBusy.assign(clusters, false);
+        for (auto station : add)
+            if (station->isInExecStage() && station->getExecOrMemEndTime() != -1)
+                isAdderBusy[station->cluster] = true;
+        for (auto station : mult)
+            if (station->isInExecStage() && station->getExecOrMemEndTime() != -1)
+                isMultBusy[station->cluster] = true;
+        for (auto station : branch)
+            if (station->isInExecStage() && station->getExecOrMemEndTime() != -1)
+                isBranchBusy[station->cluster] = true;
+        for (auto station : vec)
+            if (station->isInExecStage() && station->getExecOrMemEndTime() != -1)
+                isVectorBusy[station->cluster] = true;
+        for (auto station : memory)
+        {
+            if (station->isInExecStage() && station->getExecOrMemEndTime() != -1)
+                isMemExecBusy[station->cluster] = true;
+            isMemBusy = isMemBusy || (station->isInMemoryStage() && station->getInstruction()->memoryEnd != -1);
+        }
+    }
+
+    // Unit busy flags, register renames and the branch stall queue are
+    // recomputed from the instructions still in flight.
+    void rebuildAfterSquash()
+    {
+        rebuildUnitBusy();
+
+        vector<ReservationStation *> inFlight;
+        inFlight.insert(inFlight.end(), add.begin(), add.end());
+        inFlight.insert(inFlight.end(), mult.begin(), mult.end());
+        inFlight.insert(inFlight.end(), memory.begin(), memory.end());
+        inFlight.insert(inFlight.end(), branch.begin(), branch.end());
+        inFlight.insert(inFlight.end(), vec.begin(), vec.end());
+        sort(inFlight.begin(), inFlight.end(), [](ReservationStation *a, ReservationStation *b) { return a->getId() < b->getId(); });
+        for (auto &reg : rf)
+        {
+            reg.dataValue = "";
+        }
+        waitingRegisters.clear();
+        for (auto station : inFlight)
+        {
+            string tag = ReservationStationTypeString[station->getType()] + to_string(station->getId());
+            Instruction *pair[] = {station->getInstruction(), station->fused};
+            if (pair[1] != NULL && pair[1]->id < pair[0]->id)
+                swap(pair[0], pair[1]);
+            for (auto instr : pair)
+            {
+                if (instr != NULL && instr->dest != -1 && instr->writeCDB == -1 && !station->valuePredicted)
+                    renameRegister(instr->dest, tag);
+            }
+        }
+
+        branchInstrStallQueue.clear();
+        if (!speculative())
+        {
+            for (auto station : branch)
+                branchInstrStallQueue.push_back(station->getIssueEndTime());
+        }
+    }
+
+    void speculativeClear(vector<ReservationStation *> &resrv)
+    {
+        speculativeClear(resrv, branchIdExit);
+    }
+
+    void speculativeClear(vector<ReservationStation *> &resrv, int lastKept)
+    {
+        vector<ReservationStation *>::iterator it = resrv.begin();
+
+        while (it != resrv.end())
+        {
+            if ((*it)->getId() > lastKept)
+            {
+                (*it)->setStage(NOTISSUED);
+                stats.squashed += (*it)->fused != NULL ? 2 : 1;
+                resrv.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+};
+
+// Every parameter of a simulation run. Can be filled in directly, from a key=value
+// or flat JSON file (loadConfigFile), or one key at a time with set().
+struct SimulatorConfig
+{
+    int addUnits, multUnits, branchUnits, memoryUnits;
+    int memoryCycle, adderCycle, multCycle, branchCycle;
+    int issueCount, commitCount;
+    bool isBranchTaken, isSpeculative;
+    int quantumCycles, sharedMemoryPorts; // multi-core runs only
+    bool specialize;                      // false forces the generic core
+    int intRegisters, fpRegisters, vectorRegisters;
+    bool functional;                      // run the program instead of unrolling its loops
+    int maxInstructions;                  // functional runs stop after this many
+    map<int, long long> initialRegisters; // "init.r3 = 10", keyed by operand
+    map<long long, long long> initialMemory; // "mem.64 = 7"
+    MemoryDependenceMode memoryDependence;   // none, conservative or storeset
+    int storeSetSize;                         // SSIT and LFST entries
+    ValuePredictorMode valuePredictor;        // none, last or stride
+    int valuePredictorSize, valuePredictorThreshold;
+    int fusion;                               // FusionRule bits, "add-bne+lw-add"
+    int clusters;                             // station and unit counts are per cluster
+    SteeringPolicy steering;
+    int clusterBypassDelay;                   // extra wakeup cycles between clusters
+    string energyFile;                        // per-event energy costs, empty for no estimate
+    PrefetcherMode prefetcher;                // none, nextline or stride
+    int prefetchDegree, prefetchDistance;     // lines per trigger, and how far ahead
+    int prefetchTableSize, prefetchBufferSize, lineSize, prefetchHitCycle;
+    int intervalCycles;                       // interval statistics period, 0 for none
+    string intervalFile;                      // CSV time series, empty for none
+    bool progress;                            // live progress line on stderr per interval
+    bool dataflowLimit;                       // also report the ideal-machine bound
+    int criticalPathTop;                      // static instructions listed from the critical path
+    bool analyticModel;                       // also report the first-order IPC estimate
+    int vectorUnits;                          // VADD/VMUL stations, one vector unit per cluster
+    int vectorLength;                         // elements per vector instruction
+    int vectorLanes;                          // elements the vector unit handles per pass
+    int vectorMemoryWidth;                    // elements per memory-port beat of VLW/VSW
+    int schedulerDepth;                       // extra cycles in the wakeup/select loop
+    LoadReplayMode loadReplay;                // none, selective or flush
+
+    SimulatorConfig();
+    bool set(string key, string value, string &error);
+    bool validate(string &error);
+    bool fits(const Trace *trace, string &error);
+};
+
+// Cycle count of an ideal machine with unlimited stations, units and issue
+// width: every instruction starts once its operands are broadcast, with the
+// configured latencies. Register dependences are followed, store-to-load ones
+// too when memoryDependence orders them; control and resource limits are not.
+struct DataflowLimit
+{
+    long long cycles;
+    double ipc;
+    int criticalPathLength;                         // dynamic instructions on the longest chain
+    vector<pair<string, int>> criticalInstructions; // static instruction, times on that chain; most first
+};
+
+const int CHAIN_CLASSES = 5;
+
+// Configuration-independent summary of a trace for the analytic model.
+struct TraceProfile
+{
+    long long instructions;
+    long long typeCounts[VSW + 1]; // indexed by InstructionType
+    long long notTakenBranches;
+    bool correctPath;
+    // windowChain[k][c]: instructions of class c (add, mult, load, store,
+    // branch) on the longest register-dependence chain, averaged over
+    // consecutive windows of 2^k instructions
+    vector<vector<double>> windowChain;
+};
+
+struct SimulationResult
+{
+    int cycles;
+    int finishedInstructions;
+    double ipc;
+    SimulationStats stats;
+};
+
+// Energy of each simulated event, loaded from a key=value file. The keys are
+// the events below; "static" is charged once per cycle. Defaults are rough pJ.
+struct EnergyModel
+{
+    map<string, double> costs;
+
+    EnergyModel();
+    bool load(string fileName, string &error);
+};
+
+struct EnergyReport
+{
+    double total, perInstruction;
+    double power;                        // energy per cycle
+    double perfPerWatt;                  // IPC / power
+    vector<pair<string, double>> unitPower; // each unit's share of power
+};
+
+EnergyReport estimateEnergy(SimulationResult &result, EnergyModel &model);
+
+class TomsuloSimulator
+{
+protected:
+    vector<Instruction> instructions;
+    int issueCount, commitCount;
+    int time, nextIssue;
+    bool finished;
+    IntervalRecorder *intervals; // NULL unless interval statistics were asked for
+
+public:
+    TomsuloSimulator()
+    {
+        time = 1;
+        nextIssue = 0;
+        finished = false;
+        intervals = NULL;
+    }
+
+    TomsuloSimulator(const Trace *trace, int issueCount, int commitCount)
+    {
+        instructions.reserve(trace->instructions.size());
+        for (int i = 0; i < (int)trace->instructions.size(); i++)
+        {
+            instructions.push_back(Instruction(&trace->instructions[i], i));
+        }
+        this->issueCount = issueCount;
+        this->commitCount = commitCount;
+        time = 1;
+        nextIssue = 0;
+        finished = false;
+        intervals = NULL;
+    }
+
+    virtual ~TomsuloSimulator()
+    {
+        delete intervals;
+    }
+
+    // Takes ownership of the recorder.
+    void setIntervalRecorder(IntervalRecorder *intervals)
+    {
+        this->intervals = intervals;
+    }
+
+    virtual void setSharedMemory(SharedMemory *sharedMemory) = 0;
+    virtual SimulationStats &getStats() = 0;
+
+    // Rewinds issue to a squashed instruction; everything from it on issues again.
+    void replay(int from)
+    {
+        if (from == -1)
+            return;
+        for (int i = from; i < nextIssue; i++)
+        {
+            instructions[i] = Instruction(instructions[i].decoded, i);
+        }
+        nextIssue = min(nextIssue, from);
+    }
+
+    // Simulates one cycle. Returns false once the pipeline has drained.
+    virtual bool step() = 0;
+
+    bool isFinished()
+    {
+        return finished;
+    }
+
+    // Next cycle step() will simulate.
+    int getTime()
+    {
+        return time;
+    }
+
+    int getCycleCount()
+    {
+        return time - 1;
+    }
+
+    SimulationResult getResult();
+
+    void printTimingCycle()
+    {
+        cout << "Instruction"
+             << "\t"
+             << "Issue"
+             << "\t"
+             << "Exec"
+             << "\t"
+             << "Mem"
+             << "\t"
+             << "WrtCDB"
+             << "\t"
+             << "Commit" << endl;
+        for (auto &instr : instructions)
+        {
+            Instruction *it = &instr;
+            if (it->getStage() != FINISHED)
+                continue;
+
+            if (it->issue == -1)
+                continue;
+
+            cout << (it)->printInstruction() << "\t";
+
+            cout
+                << (it)->issue << "\t";
+
+            if (it->execStart != -1 && it->execEnd != -1)
+            {
+                cout << it->execStart << "-" << it->execEnd << "\t";
+            }
+            else
+            {
+                cout << "\t";
+            }
+
+            if (it->memoryStart != -1 && it->memoryEnd != -1)
+            {
+                cout << it->memoryStart << "-" << it->memoryEnd << "\t";
+            }
+            else
+            {
+                cout << "\t";
+            }
+            if (it->writeCDB != -1)
+                cout << it->writeCDB << "\t";
+            else
+            {
+                cout << "\t";
+            }
+            if (it->commit != -1)
+            {
+                cout << it->commit;
+            }
+
+            cout << endl;
+        }
+    }
+    void execute();
+};
+
+template <int Speculative, int Width>
+class TomsuloSimulatorCore : public TomsuloSimulator
+{
+    ReservationStationTable<Speculative, Width> *reservationTable;
+
+    int issueWidth()
+    {
+        return Width == RUNTIME_VARIANT ? issueCount : Width;
+    }
+
+public:
+    TomsuloSimulatorCore(const Trace *trace, SimulatorConfig &config) : TomsuloSimulator(trace, config.issueCount, config.commitCount)
+    {
+        reservationTable = new ReservationStationTable<Speculative, Width>(config.addUnits, config.multUnits, config.branchUnits, config.memoryUnits, config.memoryCycle, config.adderCycle, config.multCycle, config.branchCycle, config.isBranchTaken, config.isSpeculative, config.intRegisters, config.fpRegisters, config.vectorRegisters, trace->correctPath);
+        reservationTable->setMemoryDependence(config.memoryDependence, config.storeSetSize);
+        reservationTable->setValuePredictor(config.valuePredictor, config.valuePredictorSize, config.valuePredictorThreshold);
+        reservationTable->setFusionRules(config.fusion);
+        reservationTable->setClusters(config.clusters, config.steering, config.clusterBypassDelay);
+        reservationTable->setVector(config.vectorUnits, config.vectorLength, config.vectorLanes, config.vectorMemoryWidth);
+        reservationTable->setScheduler(config.schedulerDepth, config.loadReplay);
+        if (config.prefetcher != PREFETCH_NONE)
+        {
+            reservationTable->setPrefetcher(new Prefetcher(config.prefetcher, config.prefetchDegree, config.prefetchDistance, config.prefetchTableSize, config.prefetchBufferSize, config.lineSize, config.prefetchHitCycle));
+        }
+    }
+
+    ~TomsuloSimulatorCore()
+    {
+        delete reservationTable;
+    }
+
+    void setSharedMemory(SharedMemory *sharedMemory)
+    {
+        reservationTable->setSharedMemory(sharedMemory);
+    }
+
+    SimulationStats &getStats()
+    {
+        return reservationTable->getStats();
+    }
+
+    bool step()
+    {
+        bool branchStall = nextIssue < (int)instructions.size() && reservationTable->branchBlocksIssue();
+        int i = 0;
+        while ((i < issueWidth()) && (nextIssue < (int)instructions.size()))
+        {
+            Instruction *instr = &instructions[nextIssue];
+            Instruction *tail = nextIssue + 1 < (int)instructions.size() ? &instructions[nextIssue + 1] : NULL;
+            int fusedType = tail != NULL ? reservationTable->fusionType(instr, tail) : -1;
+            if (fusedType != -1)
+            {
+                // a fused pair takes one issue slot and one station
+                if (reservationTable->canIssue(fusedType == BRANCH ? BNE : LW))
+                {
+                    reservationTable->issueFused(instr, tail, time);
+                    nextIssue += 2;
+                    if (tail->type == BNE)
+                    {
+                        break;
+                    }
+                }
+                i++;
+                continue;
+            }
+            bool canIssue = reservationTable->canIssue(instr->type);
+            if (canIssue)
+            {
+                reservationTable->issue(instr, time);
+                nextIssue++;
+                if (instr->type == BNE)
+                {
+                    break;
+                }
+            }
+
+            i++;
+        }
+        reservationTable->execute(time);
+        reservationTable->execMemory(time);
+        reservationTable->writeBack(time, commitCount);
+        reservationTable->commit(time, commitCount);
+        reservationTable->advanceStage(time);
+        reservationTable->speculativeReservationClear();
+        int replayFrom = reservationTable->takeReplayPoint();
+        replay(replayFrom);
+        time++;
+        // a squash can drain the table while the replayed instructions still wait to issue
+        finished = reservationTable->isEmpty() && replayFrom == -1;
+
+        SimulationStats &stats = reservationTable->getStats();
+        CycleSample sample = reservationTable->sample();
+        sample.branchStall = branchStall;
+        stats.branchStallCycles += branchStall;
+        stats.memoryStallCycles += sample.memoryStall;
+        if (intervals != NULL)
+        {
+            intervals->sample(time - 1, sample, stats.retired);
+            if (finished)
+                intervals->finish(time - 1, stats.retired);
+        }
+        return !finished;
+    }
+};
+
+// Reusable barrier; the last thread to arrive runs onComplete before anyone is released.
+class QuantumBarrier
+{
+    mutex lock;
+    condition_variable released;
+    int count, waiting, generation;
+    function<void()> onComplete;
+
+public:
+    QuantumBarrier(int count, function<void()> onComplete)
+    {
+        this->count = count;
+        this->onComplete = onComplete;
+        waiting = 0;
+        generation = 0;
+    }
+
+    void wait()
+    {
+        unique_lock<mutex> guard(lock);
+        int arrivedGeneration = generation;
+        if (++waiting == count)
+        {
+            onComplete();
+            waiting = 0;
+            generation++;
+            released.notify_all();
+        }
+        else
+        {
+            released.wait(guard, [&] { return generation != arrivedGeneration; });
+        }
+    }
+};
+
+// Several cores, each with its own trace, stepped on host threads. Cores run
+// freely for `quantum` cycles and then meet at a barrier, so no core is ever
+// more than one quantum ahead of another (quantum 1 is strict lockstep).
+class MultiCoreSimulator
+{
+    vector<TomsuloSimulator *> cores;
+    SharedMemory *sharedMemory;
+    int quantum;
+
+public:
+    MultiCoreSimulator(vector<TomsuloSimulator *> cores, int quantum, int sharedMemoryPorts)
+    {
+        this->cores = cores;
+        this->quantum = quantum;
+        sharedMemory = new SharedMemory(sharedMemoryPorts, quantum);
+        for (auto core : cores)
+        {
+            core->setSharedMemory(sharedMemory);
+        }
+    }
+
+    void execute(int threadCount)
+    {
+        if (threadCount < 1)
+            threadCount = 1;
+        if (threadCount > (int)cores.size())
+            threadCount = cores.size();
+
+        int quantumEnd = quantum;
+        bool allFinished = false;
+        QuantumBarrier barrier(threadCount, [&] {
+            sharedMemory->endQuantum();
+            quantumEnd += quantum;
+            allFinished = true;
+            for (auto core : cores)
+            {
+                allFinished = allFinished && core->isFinished();
+            }
+        });
+
+        auto worker = [&](int first) {
+            while (true)
+            {
+                for (int c = first; c < (int)cores.size(); c += threadCount)
+                {
+                    TomsuloSimulator *core = cores[c];
+                    while (!core->isFinished() && core->getTime() <= quantumEnd)
+                    {
+                        core->step();
+                    }
+                }
+                barrier.wait();
+                if (allFinished)
+                    break;
+            }
+        };
+
+        vector<thread> threads;
+        for (int t = 1; t < threadCount; t++)
+        {
+            threads.push_back(thread(worker, t));
+        }
+        worker(0);
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+    }
+
+    SharedMemory *getSharedMemory()
+    {
+        return sharedMemory;
+    }
+};
+
+// Architectural state of a program: computes the real value, address and branch
+// outcome of every instruction so the timing model can use them as an oracle.
+class FunctionalEngine
+{
+    int intRegisters, fpRegisters;
+    vector<long long> registers;
+    unordered_map<long long, long long> memory;
+
+    long long &reg(int operand)
+    {
+        int index = registerSlot(operand, intRegisters, fpRegisters);
+        // traces that need more registers than configured are rejected by
+        // SimulatorConfig::fits; until then just keep the access in bounds
+        if (index >= (int)registers.size())
+            registers.resize(index + 1, 0);
+        return registers[index];
+    }
+
+public:
+    FunctionalEngine(SimulatorConfig &config);
+    void execute(StaticInstruction &instr);
+};
+
+bool parseInt(string value, int &out);
+bool loadConfigFile(string fileName, SimulatorConfig &config, string &error);
+Trace *readFile(string fileName);
+Trace *runProgram(vector<StaticInstruction> &program, SimulatorConfig &config);
+Trace *loadTrace(string fileName, SimulatorConfig &config, string &error);
+TomsuloSimulator *createSimulator(const Trace *trace, SimulatorConfig &config);
+bool runSimulation(const Trace *trace, SimulatorConfig &config, SimulationResult &result, string &error);
+DataflowLimit analyzeDataflow(const Trace *trace, SimulatorConfig &config);
+TraceProfile profileTrace(const Trace *trace);
+double estimateIpc(const TraceProfile &profile, SimulatorConfig &config);
+bool runBatch(const Trace *trace, vector<SimulatorConfig> &configs, int threadCount, vector<SimulationResult> &results, string &error);
+
+#endif